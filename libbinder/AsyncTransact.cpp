@@ -0,0 +1,80 @@
+#define LOG_TAG "AsyncTransact"
+
+#include <binder/AsyncTransact.h>
+
+#include <stdlib.h>
+
+#include <algorithm>
+
+#include <binder/Parcel.h>
+#include <utils/Log.h>
+
+namespace android {
+
+namespace {
+
+constexpr size_t kDefaultWorkers = 4;
+
+size_t sharedWorkers() {
+    const char* value = getenv("BINDER_TRANSACT_WORKERS");
+    if (value == nullptr) return kDefaultWorkers;
+    return std::max<size_t>(strtoul(value, nullptr, 0), 1);
+}
+
+} // namespace
+
+TransactWorkers::TransactWorkers(size_t threads) {
+    LOG_ALWAYS_FATAL_IF(threads == 0, "TransactWorkers needs at least one thread");
+    mThreads.reserve(threads);
+    for (size_t i = 0; i < threads; i++) {
+        mThreads.emplace_back(&TransactWorkers::threadLoop, this);
+    }
+}
+
+TransactWorkers::~TransactWorkers() {
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mStopping = true;
+    }
+    mCond.notify_all();
+    for (auto& t : mThreads) {
+        t.join();
+    }
+}
+
+TransactWorkers& TransactWorkers::shared() {
+    // Never destroyed: workers may still be busy while the process exits.
+    static TransactWorkers* workers = new TransactWorkers(sharedWorkers());
+    return *workers;
+}
+
+void TransactWorkers::transact(const sp<IBinder>& binder, uint32_t code, const Parcel& data,
+                               Parcel* reply, uint32_t flags, Callback done) {
+    post([binder, code, &data, reply, flags, done = std::move(done)] {
+        done(binder->transact(code, data, reply, flags));
+    });
+}
+
+void TransactWorkers::post(std::function<void()> work) {
+    {
+        std::lock_guard<std::mutex> guard(mLock);
+        mQueue.push_back(std::move(work));
+    }
+    mCond.notify_one();
+}
+
+void TransactWorkers::threadLoop() {
+    while (true) {
+        std::function<void()> work;
+        {
+            std::unique_lock<std::mutex> lock(mLock);
+            mCond.wait(lock, [this] { return mStopping || !mQueue.empty(); });
+            if (mQueue.empty()) break;
+            work = std::move(mQueue.front());
+            mQueue.pop_front();
+        }
+        work();
+    }
+}
+
+} // namespace android
@@ -0,0 +1,206 @@
+#define LOG_TAG "BufferUsage"
+
+#include <binder/BufferUsage.h>
+
+#include <errno.h>
+#include <linux/android/binder.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <string>
+
+#include <binder/ProcessState.h>
+#include <utils/Log.h>
+
+namespace android {
+
+namespace {
+
+// The driver ignores anything beyond 4MB.
+constexpr size_t kMaxVmSize = 4 * 1024 * 1024;
+
+size_t pageSize() {
+    return sysconf(_SC_PAGE_SIZE);
+}
+
+size_t clampVmSize(size_t bytes) {
+    // At least two pages: half the buffer is async space.
+    bytes = std::clamp(bytes, 2 * pageSize(), kMaxVmSize);
+    return bytes & ~(pageSize() - 1);
+}
+
+size_t defaultVmSize() {
+    const size_t fallback = 1024 * 1024 - 2 * pageSize();
+    const char* value = getenv("BINDER_VM_SIZE");
+    if (value == nullptr || *value == '\0') return fallback;
+
+    char* end;
+    unsigned long long bytes = strtoull(value, &end, 0);
+    if (*end == 'K' || *end == 'k') {
+        bytes *= 1024;
+        end++;
+    } else if (*end == 'M' || *end == 'm') {
+        bytes *= 1024 * 1024;
+        end++;
+    }
+    if (*end != '\0' || bytes == 0) {
+        ALOGW("Ignoring BINDER_VM_SIZE=%s", value);
+        return fallback;
+    }
+    return clampVmSize(bytes);
+}
+
+std::atomic<size_t> gVmSize{0};
+std::atomic<bool> gMapped{false};
+
+std::atomic<size_t> gBuffers{0};
+std::atomic<size_t> gBytes{0};
+std::atomic<size_t> gMaxBuffers{0};
+std::atomic<size_t> gMaxBytes{0};
+std::atomic<uint64_t> gFailedReplies{0};
+std::atomic<uint64_t> gAllocationFailures{0};
+
+struct FailedReply {
+    bool failed = false;
+    int error = 0;
+};
+
+thread_local FailedReply tFailedReply;
+
+// What the driver allocates for a buffer, not counting scatter-gather
+// buffers it does not tell the receiver about.
+size_t allocationSize(size_t dataSize, size_t objectsCount) {
+    auto align8 = [](size_t size) { return (size + 7) & ~size_t(7); };
+    return align8(dataSize) + align8(objectsCount * sizeof(binder_size_t));
+}
+
+void raise(std::atomic<size_t>* max, size_t value) {
+    size_t current = max->load(std::memory_order_relaxed);
+    while (value > current &&
+           !max->compare_exchange_weak(current, value, std::memory_order_relaxed)) {
+    }
+}
+
+std::string statsPath() {
+    // binder_logs lives next to the device on binderfs.
+    std::string driver = ProcessState::self()->getDriverName().c_str();
+    size_t slash = driver.rfind('/');
+    if (slash == std::string::npos) return "/dev/binderfs/binder_logs/stats";
+    return driver.substr(0, slash) + "/binder_logs/stats";
+}
+
+void readDriverStats(BufferUsage::Stats* stats) {
+    std::ifstream in(statsPath());
+    if (!in) return;
+
+    const pid_t self = getpid();
+    bool inSelf = false;
+    std::string line;
+    while (std::getline(in, line)) {
+        int pid;
+        if (sscanf(line.c_str(), "proc %d", &pid) == 1) {
+            if (inSelf) break;
+            inSelf = pid == self;
+            continue;
+        }
+        if (!inSelf) continue;
+
+        long long value;
+        int active, lru, free;
+        if (sscanf(line.c_str(), "  buffers: %lld", &value) == 1) {
+            stats->driverBuffers = value;
+        } else if (sscanf(line.c_str(), "  free async space %lld", &value) == 1) {
+            stats->freeAsyncSpace = value;
+        } else if (sscanf(line.c_str(), "  pages: %d:%d:%d", &active, &lru, &free) == 3) {
+            stats->pagesActive = active;
+        } else if (sscanf(line.c_str(), "  pages high watermark: %lld", &value) == 1) {
+            stats->pagesHighWatermark = value;
+        }
+    }
+}
+
+} // namespace
+
+size_t BufferUsage::vmSize() {
+    size_t size = gVmSize.load(std::memory_order_relaxed);
+    if (size == 0) {
+        size_t expected = 0;
+        size = defaultVmSize();
+        if (!gVmSize.compare_exchange_strong(expected, size)) size = expected;
+    }
+    return size;
+}
+
+size_t BufferUsage::mapSize() {
+    gMapped.store(true, std::memory_order_relaxed);
+    return vmSize();
+}
+
+bool BufferUsage::setVmSize(size_t bytes) {
+    if (gMapped.load(std::memory_order_relaxed)) {
+        ALOGW("setVmSize(%zu) after the binder buffer was mapped", bytes);
+        return false;
+    }
+    gVmSize.store(clampVmSize(bytes), std::memory_order_relaxed);
+    return true;
+}
+
+BufferUsage::Stats BufferUsage::stats() {
+    Stats stats;
+    stats.vmSize = vmSize();
+    stats.buffers = gBuffers.load(std::memory_order_relaxed);
+    stats.bytes = gBytes.load(std::memory_order_relaxed);
+    stats.maxBuffers = gMaxBuffers.load(std::memory_order_relaxed);
+    stats.maxBytes = gMaxBytes.load(std::memory_order_relaxed);
+    stats.failedReplies = gFailedReplies.load(std::memory_order_relaxed);
+    stats.allocationFailures = gAllocationFailures.load(std::memory_order_relaxed);
+    readDriverStats(&stats);
+    return stats;
+}
+
+void BufferUsage::resetHighWatermark() {
+    gMaxBuffers.store(gBuffers.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    gMaxBytes.store(gBytes.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void BufferUsage::noteReceived(size_t dataSize, size_t objectsCount) {
+    const size_t buffers = gBuffers.fetch_add(1, std::memory_order_relaxed) + 1;
+    const size_t size = allocationSize(dataSize, objectsCount);
+    const size_t bytes = gBytes.fetch_add(size, std::memory_order_relaxed) + size;
+    raise(&gMaxBuffers, buffers);
+    raise(&gMaxBytes, bytes);
+}
+
+void BufferUsage::noteFreed(size_t dataSize, size_t objectsCount) {
+    gBuffers.fetch_sub(1, std::memory_order_relaxed);
+    gBytes.fetch_sub(allocationSize(dataSize, objectsCount), std::memory_order_relaxed);
+}
+
+void BufferUsage::clearFailedReply() {
+    tFailedReply = FailedReply();
+}
+
+void BufferUsage::noteFailedReply(int driverFd) {
+    // The driver hands the extended error out only once.
+    binder_extended_error ee = {};
+    int error = 0;
+    if (ioctl(driverFd, BINDER_GET_EXTENDED_ERROR, &ee) == 0) error = ee.param;
+
+    tFailedReply.failed = true;
+    tFailedReply.error = error;
+    gFailedReplies.fetch_add(1, std::memory_order_relaxed);
+    if (error == -ENOSPC) gAllocationFailures.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool BufferUsage::lastFailedReply(int* error) {
+    *error = tFailedReply.error;
+    return tFailedReply.failed;
+}
+
+} // namespace android
@@ -0,0 +1,132 @@
+#define LOG_TAG "BusyPoll"
+
+#include <binder/BusyPoll.h>
+
+#include <inttypes.h>
+#include <poll.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <utility>
+
+#include <utils/Log.h>
+
+namespace android {
+
+namespace {
+
+std::atomic<nsecs_t> gMinSpin{0};
+std::atomic<nsecs_t> gMaxSpin{0};
+std::atomic<uint64_t> gSpins{0};
+std::atomic<uint64_t> gHits{0};
+// Whether a thread of the process is spinning, see BusyPoll.
+std::atomic<bool> gSpinning{false};
+
+struct PollState {
+    bool waiting = false;
+    nsecs_t waitStart = 0;
+    // Moving average of the time the thread waited for a command, -1 until
+    // the first wait. Seeded with half the spin limit so that a busy thread
+    // spins from its first wait.
+    nsecs_t idleAverage = -1;
+};
+
+thread_local PollState tState;
+
+inline void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield" ::: "memory");
+#endif
+}
+
+bool initFromEnv() {
+    const char* value = getenv("BINDER_BUSY_POLL");
+    if (value == nullptr || *value == '\0') return false;
+
+    char* end;
+    BusyPoll::Policy policy;
+    policy.maxSpin = us2ns(strtoll(value, &end, 10));
+    if (*end == ',') policy.minSpin = us2ns(strtoll(end + 1, nullptr, 10));
+    BusyPoll::setPolicy(policy);
+    ALOGI("Busy polling up to %" PRId64 " ns", policy.maxSpin);
+    return true;
+}
+
+[[maybe_unused]] const bool gBusyPollFromEnv = initFromEnv();
+
+} // namespace
+
+void BusyPoll::setPolicy(const Policy& policy) {
+    nsecs_t minSpin = std::max<nsecs_t>(policy.minSpin, 0);
+    nsecs_t maxSpin = std::max<nsecs_t>(policy.maxSpin, 0);
+    if (maxSpin == 0) {
+        minSpin = 0;
+    } else if (minSpin > maxSpin) {
+        // E.g. BINDER_BUSY_POLL=10,20 with the limits the wrong way round.
+        ALOGW("Busy poll minimum %" PRId64 " ns above maximum %" PRId64 " ns, swapped", minSpin,
+              maxSpin);
+        std::swap(minSpin, maxSpin);
+    }
+    gMinSpin.store(minSpin, std::memory_order_relaxed);
+    gMaxSpin.store(maxSpin, std::memory_order_relaxed);
+}
+
+BusyPoll::Policy BusyPoll::getPolicy() {
+    Policy policy;
+    policy.minSpin = gMinSpin.load(std::memory_order_relaxed);
+    policy.maxSpin = gMaxSpin.load(std::memory_order_relaxed);
+    return policy;
+}
+
+bool BusyPoll::isEnabled() {
+    return gMaxSpin.load(std::memory_order_relaxed) > 0;
+}
+
+BusyPoll::Stats BusyPoll::stats() {
+    Stats stats;
+    stats.spins = gSpins.load(std::memory_order_relaxed);
+    stats.hits = gHits.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void BusyPoll::spin(int fd) {
+    const Policy policy = getPolicy();
+    if (policy.maxSpin <= 0) return;
+
+    PollState& state = tState;
+    const nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    state.waiting = true;
+    state.waitStart = start;
+    if (state.idleAverage < 0) state.idleAverage = policy.maxSpin / 2;
+
+    const nsecs_t budget = state.idleAverage < policy.maxSpin
+            ? std::clamp(state.idleAverage * 2, policy.minSpin, policy.maxSpin)
+            : policy.minSpin;
+    if (budget <= 0 || gSpinning.exchange(true, std::memory_order_acquire)) return;
+
+    gSpins.fetch_add(1, std::memory_order_relaxed);
+    pollfd pfd = {fd, POLLIN, 0};
+    const nsecs_t deadline = start + budget;
+    do {
+        if (poll(&pfd, 1, 0) > 0) {
+            gHits.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+        cpuRelax();
+    } while (systemTime(SYSTEM_TIME_MONOTONIC) < deadline);
+    gSpinning.store(false, std::memory_order_release);
+}
+
+void BusyPoll::woke() {
+    PollState& state = tState;
+    if (!state.waiting) return;
+    state.waiting = false;
+
+    const nsecs_t idle = systemTime(SYSTEM_TIME_MONOTONIC) - state.waitStart;
+    state.idleAverage += (idle - state.idleAverage) / 8;
+}
+
+} // namespace android
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+#include <binder/Parcel.h>
+
+namespace android {
+
+// Locates the interface descriptor in a kernel binder payload written by
+// Parcel::writeInterfaceToken(): strict mode policy, work source and header
+// words followed by the String16 descriptor. Returns nullptr and sets
+// |outLen| (in char16_t units) to 0 when |data| has no interface token.
+inline const char16_t* findInterfaceDescriptor(const Parcel& data, size_t* outLen) {
+    constexpr size_t kTokenHeader = 3 * sizeof(int32_t);
+    constexpr size_t kOffset = kTokenHeader + sizeof(int32_t);
+    const uint8_t* p = data.data();
+    size_t size = data.dataSize();
+    *outLen = 0;
+    if (p == nullptr || size < kOffset + sizeof(char16_t)) return nullptr;
+
+    int32_t len;
+    memcpy(&len, p + kTokenHeader, sizeof(len));
+    if (len <= 0 || static_cast<size_t>(len) > (size - kOffset) / sizeof(char16_t) - 1) {
+        return nullptr;
+    }
+    *outLen = len;
+    return reinterpret_cast<const char16_t*>(p + kOffset);
+}
+
+} // namespace android
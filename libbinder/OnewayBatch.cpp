@@ -0,0 +1,114 @@
+#define LOG_TAG "OnewayBatch"
+
+#include <binder/OnewayBatch.h>
+
+#include <memory>
+#include <vector>
+
+#include <binder/IPCThreadState.h>
+#include <binder/Parcel.h>
+#include <binder/ScatterGather.h>
+#include <utils/Log.h>
+
+namespace android {
+
+namespace {
+
+struct BatchState {
+    size_t depth = 0;
+    // Targets of the transactions written to mOut.
+    std::vector<int32_t> pending;
+    size_t bytes = 0;
+    OnewayBatch::Limits limits;
+    std::vector<std::unique_ptr<Parcel>> parcels;
+    status_t error = NO_ERROR;
+    bool flushing = false;
+};
+
+thread_local BatchState tState;
+
+} // namespace
+
+OnewayBatch::OnewayBatch() : OnewayBatch(Limits()) {}
+
+OnewayBatch::OnewayBatch(const Limits& limits) {
+    if (tState.depth++ == 0) {
+        tState.limits = limits;
+        tState.error = NO_ERROR;
+    }
+}
+
+OnewayBatch::~OnewayBatch() {
+    LOG_ALWAYS_FATAL_IF(tState.depth == 0, "OnewayBatch destroyed on another thread");
+    if (--tState.depth == 0) {
+        status_t err = flush();
+        ALOGW_IF(err != NO_ERROR, "Dropping error %d of a batched oneway call", err);
+    }
+}
+
+status_t OnewayBatch::flush() {
+    if (!tState.pending.empty() || !tState.parcels.empty()) {
+        recordError(IPCThreadState::self()->flushOnewayBatch());
+    }
+    status_t err = tState.error;
+    tState.error = NO_ERROR;
+    return err;
+}
+
+size_t OnewayBatch::pending() {
+    return tState.pending.size();
+}
+
+const Parcel* OnewayBatch::defer(const Parcel& data) {
+    // The buffers need only live until transact() returns, see ScatterGather.
+    if (tState.depth == 0 || ScatterGather::hasBuffers(data)) return nullptr;
+
+    auto copy = std::make_unique<Parcel>();
+    if (copy->appendFrom(&data, 0, data.dataSize()) != NO_ERROR) {
+        return nullptr;
+    }
+    tState.bytes += copy->dataSize();
+    tState.parcels.push_back(std::move(copy));
+    return tState.parcels.back().get();
+}
+
+void OnewayBatch::commit(int32_t handle) {
+    tState.pending.push_back(handle);
+}
+
+bool OnewayBatch::full() {
+    return tState.pending.size() >= tState.limits.maxTransactions ||
+            tState.bytes >= tState.limits.maxBytes;
+}
+
+std::vector<int32_t> OnewayBatch::takePending() {
+    std::vector<int32_t> pending;
+    pending.swap(tState.pending);
+    tState.flushing = true;
+    return pending;
+}
+
+void OnewayBatch::releaseParcels() {
+    tState.parcels.clear();
+    tState.bytes = 0;
+    tState.flushing = false;
+}
+
+void OnewayBatch::recordError(status_t err) {
+    if (tState.error == NO_ERROR) tState.error = err;
+}
+
+bool OnewayBatch::flushing() {
+    return tState.flushing;
+}
+
+void OnewayBatch::dropWritten(Parcel* out, size_t written) {
+    LOG_ALWAYS_FATAL_IF(written > out->dataSize(), "Driver consumed %zu of %zu bytes", written,
+                        out->dataSize());
+    // mOut only holds commands, there are no objects to keep track of.
+    std::vector<uint8_t> rest(out->data() + written, out->data() + out->dataSize());
+    out->setDataSize(0);
+    out->write(rest.data(), rest.size());
+}
+
+} // namespace android
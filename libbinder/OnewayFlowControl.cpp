@@ -0,0 +1,155 @@
+#define LOG_TAG "OnewayFlowControl"
+
+#include <binder/OnewayFlowControl.h>
+
+#include <errno.h>
+#include <time.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <binder/BufferUsage.h>
+#include <binder/Parcel.h>
+#include <binder/ProcessState.h>
+#include <utils/Log.h>
+
+namespace android {
+
+namespace {
+
+using Pressure = OnewayFlowControl::Pressure;
+
+constexpr nsecs_t kMinBackoff = 50000;     // 50us
+constexpr nsecs_t kMaxBackoff = 10000000;  // 10ms
+
+struct Target {
+    wp<IBinder> binder;
+    Pressure pressure = Pressure::None;
+};
+
+std::mutex gLock;
+// Only targets under pressure are tracked, keyed by handle.
+std::map<int32_t, Target> gTargets;
+std::atomic<size_t> gTracked{0};
+std::shared_ptr<OnewayFlowControl::Listener> gListener;
+
+thread_local bool tSpamSuspect = false;
+thread_local Pressure tLastPressure = Pressure::None;
+
+bool isOutOfSpace() {
+    int error;
+    if (!BufferUsage::lastFailedReply(&error)) return false;
+    // Kernels before 6.0 cannot tell; a full receiver is the usual reason
+    // for a oneway call to fail.
+    return error == 0 || error == -ENOSPC;
+}
+
+void sleepFor(nsecs_t duration) {
+    timespec ts = {static_cast<time_t>(duration / 1000000000ll),
+                   static_cast<long>(duration % 1000000000ll)};
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+} // namespace
+
+void OnewayFlowControl::setListener(Listener listener) {
+    auto shared = listener ? std::make_shared<Listener>(std::move(listener)) : nullptr;
+    std::lock_guard<std::mutex> guard(gLock);
+    gListener = std::move(shared);
+}
+
+Pressure OnewayFlowControl::pressure(const sp<IBinder>& target) {
+    if (target == nullptr || gTracked.load(std::memory_order_relaxed) == 0) {
+        return Pressure::None;
+    }
+    std::lock_guard<std::mutex> guard(gLock);
+    for (const auto& [handle, t] : gTargets) {
+        if (t.binder.unsafe_get() == target.get()) return t.pressure;
+    }
+    return Pressure::None;
+}
+
+status_t OnewayFlowControl::send(const sp<IBinder>& target, uint32_t code, const Parcel& data,
+                                 Mode mode, nsecs_t timeout) {
+    if (target == nullptr) return BAD_VALUE;
+
+    const nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    nsecs_t backoff = kMinBackoff;
+    while (true) {
+        if (mode == Mode::Blocking && pressure(target) == Pressure::SpamSuspect) {
+            // Give the receiver a chance to drain before it fills up.
+            sleepFor(kMinBackoff);
+        }
+
+        tLastPressure = Pressure::None;
+        status_t err = target->transact(code, data, nullptr, IBinder::FLAG_ONEWAY);
+        if (tLastPressure != Pressure::Full) return err;
+        if (mode == Mode::NonBlocking) return WOULD_BLOCK;
+
+        nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+        if (timeout >= 0 && elapsed + backoff > timeout) return TIMED_OUT;
+        sleepFor(backoff);
+        backoff = std::min(backoff * 2, kMaxBackoff);
+    }
+}
+
+void OnewayFlowControl::noteSpamSuspect() {
+    tSpamSuspect = true;
+}
+
+void OnewayFlowControl::onOnewaySent(int32_t handle, status_t err) {
+    Pressure pressure = Pressure::None;
+    if (err == FAILED_TRANSACTION && isOutOfSpace()) {
+        pressure = Pressure::Full;
+    } else if (tSpamSuspect) {
+        pressure = Pressure::SpamSuspect;
+    }
+    tSpamSuspect = false;
+    tLastPressure = pressure;
+    if (pressure == Pressure::None && gTracked.load(std::memory_order_relaxed) == 0) return;
+
+    // Looked up outside of gLock; a proxy can only be needed on this rare
+    // path.
+    sp<IBinder> binder;
+    if (pressure != Pressure::None) {
+        binder = ProcessState::self()->getStrongProxyForHandle(handle);
+    }
+
+    std::shared_ptr<Listener> listener;
+    {
+        std::lock_guard<std::mutex> guard(gLock);
+        auto it = gTargets.find(handle);
+        if (it != gTargets.end() && pressure != Pressure::None &&
+            it->second.binder.unsafe_get() != binder.get()) {
+            // The handle was released and reused for another node.
+            gTargets.erase(it);
+            gTracked.fetch_sub(1, std::memory_order_relaxed);
+            it = gTargets.end();
+        }
+        Pressure previous = it != gTargets.end() ? it->second.pressure : Pressure::None;
+        if (pressure == previous) return;
+
+        if (pressure == Pressure::None) {
+            binder = it->second.binder.promote();
+            gTargets.erase(it);
+            gTracked.fetch_sub(1, std::memory_order_relaxed);
+        } else if (it == gTargets.end()) {
+            gTargets.emplace(handle, Target{binder, pressure});
+            gTracked.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            it->second.pressure = pressure;
+        }
+        listener = gListener;
+    }
+    ALOGW_IF(pressure == Pressure::Full, "Oneway receiver (handle %d) is out of async space",
+             handle);
+    if (listener != nullptr && binder != nullptr) {
+        (*listener)(binder, pressure);
+    }
+}
+
+} // namespace android
@@ -0,0 +1,38 @@
+#define LOG_TAG "ParcelObjectIndex"
+
+#include <binder/ParcelObjectIndex.h>
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace android {
+
+size_t ParcelObjectIndex::objectSize(const uint8_t* data, binder_size_t offset) {
+    binder_object_header hdr;
+    memcpy(&hdr, data + offset, sizeof(hdr));
+    return hdr.type == BINDER_TYPE_PTR ? sizeof(binder_buffer_object) : sizeof(flat_binder_object);
+}
+
+size_t ParcelObjectIndex::seek(const uint8_t* data, const binder_size_t* objects, size_t count,
+                               size_t position) {
+    const binder_size_t* end = objects + count;
+    return std::partition_point(objects, end,
+                                [data, position](binder_size_t offset) {
+                                    return offset + objectSize(data, offset) <= position;
+                                }) -
+            objects;
+}
+
+void ParcelObjectIndex::sort(binder_size_t* objects, size_t count) {
+    if (!std::is_sorted(objects, objects + count)) {
+        std::sort(objects, objects + count);
+    }
+}
+
+void ParcelObjectIndex::noteAppend(const binder_size_t* objects, size_t count,
+                                   binder_size_t offset, bool* sorted) {
+    if (count > 0 && objects[count - 1] > offset) *sorted = false;
+}
+
+} // namespace android
@@ -0,0 +1,81 @@
+#define LOG_TAG "ParcelSizing"
+
+#include <binder/ParcelSizing.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <limits>
+#include <typeindex>
+#include <typeinfo>
+#include <unordered_map>
+
+#include <binder/Parcel.h>
+#include <binder/Parcelable.h>
+
+namespace android {
+
+namespace {
+
+// Writes of a type after which its reservation may shrink to the largest
+// size seen in that window.
+constexpr uint32_t kWindow = 64;
+
+struct Hint {
+    size_t size = 0;
+    size_t windowMax = 0;
+    uint32_t writes = 0;
+};
+
+thread_local std::unordered_map<std::type_index, Hint> tHints;
+
+void learn(Hint* hint, size_t size) {
+    hint->size = std::max(hint->size, size);
+    hint->windowMax = std::max(hint->windowMax, size);
+    if (++hint->writes == kWindow) {
+        hint->size = hint->windowMax;
+        hint->windowMax = 0;
+        hint->writes = 0;
+    }
+}
+
+status_t writeSized(Parcel* parcel, const Parcelable& value, bool withMarker) {
+    // The non-null marker Parcel::writeParcelable() puts in front.
+    const size_t marker = withMarker ? sizeof(int32_t) : 0;
+    Hint& hint = tHints[std::type_index(typeid(value))];
+    if (hint.size > 0) {
+        // Only an optimization; a failure shows up in the write below.
+        ParcelSizing::reserve(parcel, marker + hint.size);
+    }
+
+    const size_t start = parcel->dataPosition();
+    status_t err = withMarker ? parcel->writeParcelable(value) : value.writeToParcel(parcel);
+    if (err != OK) return err;
+    learn(&hint, parcel->dataPosition() - start - marker);
+    return OK;
+}
+
+} // namespace
+
+size_t ParcelSizing::sizeOf(const Parcelable& value) {
+    // Buffers of short-lived Parcels are recycled (see ParcelStorage).
+    Parcel scratch;
+    if (value.writeToParcel(&scratch) != OK) return 0;
+    return scratch.dataSize();
+}
+
+status_t ParcelSizing::reserve(Parcel* parcel, size_t bytes) {
+    const size_t position = parcel->dataPosition();
+    if (bytes > std::numeric_limits<int32_t>::max() - position) return BAD_VALUE;
+    return parcel->setDataCapacity(position + bytes);
+}
+
+status_t ParcelSizing::write(Parcel* parcel, const Parcelable& value) {
+    return writeSized(parcel, value, false);
+}
+
+status_t ParcelSizing::writeParcelable(Parcel* parcel, const Parcelable& value) {
+    return writeSized(parcel, value, true);
+}
+
+} // namespace android
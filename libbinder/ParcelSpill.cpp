@@ -0,0 +1,226 @@
+#define LOG_TAG "ParcelSpill"
+
+#include <binder/ParcelSpill.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include <binder/Parcel.h>
+#include <utils/Log.h>
+
+namespace android {
+
+namespace {
+
+constexpr size_t kDefaultThreshold = 256 * 1024;
+
+// Header of a spilled Parcel, followed by the memfd: magic, version and
+// the size of the original data.
+constexpr int32_t kMagic = 0x4c505342; // 'BSPL'
+constexpr int32_t kVersion = 1;
+constexpr size_t kHeaderSize = 2 * sizeof(int32_t) + sizeof(uint64_t);
+
+constexpr int kRequiredSeals = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+
+std::atomic<size_t> gThreshold{[] {
+    const char* value = getenv("BINDER_SPILL_THRESHOLD");
+    if (value == nullptr || *value == '\0') return kDefaultThreshold;
+    return static_cast<size_t>(strtoull(value, nullptr, 0));
+}()};
+
+thread_local std::unique_ptr<Parcel> tSpilled;
+
+// A transaction buffer kept until the mapping of its spilled data goes.
+struct HeldBuffer {
+    ParcelSpill::ReleaseFunc release;
+    const uint8_t* data;
+    size_t dataSize;
+    const binder_size_t* objects;
+    size_t objectsSize;
+};
+
+std::mutex gHeldLock;
+// Keyed by the address of the mapping.
+std::map<const uint8_t*, HeldBuffer> gHeld;
+
+// Returns a sealed memfd holding a copy of |data|, or -1.
+int createSealed(const uint8_t* data, size_t size) {
+    int fd = memfd_create("binder-spill", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        ALOGE("memfd_create: %s", strerror(errno));
+        return -1;
+    }
+    if (ftruncate(fd, size) != 0) {
+        ALOGE("Cannot size a %zu byte spill: %s", size, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    void* map = mmap(nullptr, size, PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        ALOGE("Cannot map a %zu byte spill: %s", size, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    memcpy(map, data, size);
+    munmap(map, size);
+    // The receiver maps the data in place, so it must not change or shrink
+    // under it.
+    if (fcntl(fd, F_ADD_SEALS, kRequiredSeals | F_SEAL_SEAL) != 0) {
+        ALOGE("Cannot seal a spill: %s", strerror(errno));
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool isSpilled(const Parcel& parcel) {
+    if (parcel.objectsCount() != 1 ||
+        parcel.dataSize() != kHeaderSize + sizeof(flat_binder_object)) {
+        return false;
+    }
+    int32_t magic;
+    int32_t version;
+    return parcel.readInt32(&magic) == NO_ERROR && magic == kMagic &&
+            parcel.readInt32(&version) == NO_ERROR && version == kVersion;
+}
+
+// Maps |size| bytes of the spilled data in |fd|, or returns nullptr.
+const uint8_t* mapSealed(int fd, uint64_t size) {
+    // A sender that did not seal the memfd could change the data while it
+    // is read, or truncate it under the mapping.
+    struct stat st;
+    if (fd < 0 || size == 0 || size > INT32_MAX ||
+        (fcntl(fd, F_GET_SEALS) & kRequiredSeals) != kRequiredSeals || fstat(fd, &st) != 0 ||
+        static_cast<uint64_t>(st.st_size) < size) {
+        ALOGE("Ignoring a malformed spilled transaction of %" PRIu64 " bytes", size);
+        return nullptr;
+    }
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        ALOGE("Cannot map a %" PRIu64 " byte spill: %s", size, strerror(errno));
+        return nullptr;
+    }
+    return static_cast<const uint8_t*>(data);
+}
+
+} // namespace
+
+size_t ParcelSpill::threshold() {
+    return gThreshold.load(std::memory_order_relaxed);
+}
+
+void ParcelSpill::setThreshold(size_t bytes) {
+    gThreshold.store(bytes, std::memory_order_relaxed);
+}
+
+const Parcel* ParcelSpill::spill(const Parcel& data) {
+    release();
+    const size_t limit = threshold();
+    if (limit == 0 || data.dataSize() <= limit || data.objectsCount() > 0 ||
+        data.errorCheck() != NO_ERROR) {
+        return nullptr;
+    }
+
+    int fd = createSealed(data.data(), data.dataSize());
+    // Sending the Parcel as is may still fit.
+    if (fd < 0) return nullptr;
+
+    auto spilled = std::make_unique<Parcel>();
+    spilled->writeInt32(kMagic);
+    spilled->writeInt32(kVersion);
+    spilled->writeUint64(data.dataSize());
+    if (spilled->writeFileDescriptor(fd, true /*takeOwnership*/) != NO_ERROR) {
+        close(fd);
+        return nullptr;
+    }
+    tSpilled = std::move(spilled);
+    return tSpilled.get();
+}
+
+void ParcelSpill::release() {
+    tSpilled.reset();
+}
+
+bool ParcelSpill::map(const Parcel& parcel, const uint8_t** outData, size_t* outSize) {
+    const size_t position = parcel.dataPosition();
+    parcel.setDataPosition(0);
+    if (!isSpilled(parcel)) {
+        parcel.setDataPosition(position);
+        return false;
+    }
+
+    uint64_t size = 0;
+    int fd = -1;
+    if (parcel.readUint64(&size) == NO_ERROR) fd = parcel.readFileDescriptor();
+    parcel.setDataPosition(position);
+
+    const uint8_t* data = mapSealed(fd, size);
+    if (data == nullptr) return false;
+    *outData = data;
+    *outSize = size;
+    return true;
+}
+
+bool ParcelSpill::map(const binder_transaction_data& tr, ReleaseFunc release,
+                      const uint8_t** outData, size_t* outSize) {
+    // Same layout as isSpilled(), read straight from the buffer.
+    if (tr.data_size != kHeaderSize + sizeof(flat_binder_object) ||
+        tr.offsets_size != sizeof(binder_size_t)) {
+        return false;
+    }
+    const auto* buffer = reinterpret_cast<const uint8_t*>(tr.data.ptr.buffer);
+    const auto* objects = reinterpret_cast<const binder_size_t*>(tr.data.ptr.offsets);
+    int32_t header[2];
+    uint64_t size;
+    flat_binder_object object;
+    memcpy(header, buffer, sizeof(header));
+    memcpy(&size, buffer + sizeof(header), sizeof(size));
+    memcpy(&object, buffer + kHeaderSize, sizeof(object));
+    if (header[0] != kMagic || header[1] != kVersion || objects[0] != kHeaderSize ||
+        object.hdr.type != BINDER_TYPE_FD) {
+        return false;
+    }
+
+    const uint8_t* data = mapSealed(object.handle, size);
+    if (data == nullptr) return false;
+    // The buffer never gets wrapped in a Parcel, which would close the fd.
+    close(object.handle);
+    {
+        std::lock_guard<std::mutex> guard(gHeldLock);
+        gHeld[data] = HeldBuffer{release, buffer, tr.data_size, objects, 1};
+    }
+    *outData = data;
+    *outSize = size;
+    return true;
+}
+
+void ParcelSpill::unmap(const uint8_t* data, size_t dataSize, const binder_size_t* /*objects*/,
+                        size_t /*objectsSize*/) {
+    // Looked up before munmap(), after which another spill may get the
+    // same address.
+    HeldBuffer held = {};
+    {
+        std::lock_guard<std::mutex> guard(gHeldLock);
+        if (auto it = gHeld.find(data); it != gHeld.end()) {
+            held = it->second;
+            gHeld.erase(it);
+        }
+    }
+    munmap(const_cast<uint8_t*>(data), dataSize);
+    if (held.release != nullptr) {
+        held.release(held.data, held.dataSize, held.objects, held.objectsSize);
+    }
+}
+
+} // namespace android
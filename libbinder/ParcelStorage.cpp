@@ -0,0 +1,142 @@
+#define LOG_TAG "ParcelStorage"
+
+#include <binder/ParcelStorage.h>
+
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+
+namespace android {
+
+namespace {
+
+constexpr size_t kMinShift = 6;  // kMinSize
+constexpr size_t kClasses = 11;  // kMinSize .. kMaxCached
+constexpr size_t kPerClass = 8;
+
+static_assert(ParcelStorage::kMinSize == 1u << kMinShift);
+static_assert(ParcelStorage::kMaxCached == ParcelStorage::kMinSize << (kClasses - 1));
+
+// Trivially destructible, so it stays usable while the thread exits; the
+// cached buffers are freed by a pthread key destructor instead.
+struct Cache {
+    uint8_t* blocks[kClasses][kPerClass];
+    size_t counts[kClasses];
+    size_t bytes;
+    ParcelStorage::Stats stats;
+    bool registered;
+    bool exited;
+};
+
+thread_local Cache tCache;
+
+pthread_key_t gExitKey;
+pthread_once_t gExitKeyOnce = PTHREAD_ONCE_INIT;
+
+bool cacheEnabled() {
+    static const bool enabled = [] {
+        const char* value = getenv("BINDER_PARCEL_CACHE");
+        return value == nullptr || strcmp(value, "0") != 0;
+    }();
+    return enabled;
+}
+
+// Requires size <= kMaxCached.
+size_t classOf(size_t size) {
+    if (size <= ParcelStorage::kMinSize) return 0;
+    return sizeof(unsigned long) * 8 - __builtin_clzl(size - 1) - kMinShift;
+}
+
+size_t classSize(size_t c) {
+    return ParcelStorage::kMinSize << c;
+}
+
+void trimCache(Cache* cache) {
+    for (size_t c = 0; c < kClasses; c++) {
+        while (cache->counts[c] > 0) {
+            free(cache->blocks[c][--cache->counts[c]]);
+        }
+    }
+    cache->bytes = 0;
+}
+
+void onThreadExit(void*) {
+    trimCache(&tCache);
+    // Parcels destroyed later on this thread free their buffers directly.
+    tCache.exited = true;
+}
+
+Cache* threadCache() {
+    if (!cacheEnabled()) return nullptr;
+    Cache* cache = &tCache;
+    if (cache->exited) return nullptr;
+    if (!cache->registered) {
+        pthread_once(&gExitKeyOnce, [] { pthread_key_create(&gExitKey, onThreadExit); });
+        pthread_setspecific(gExitKey, cache);
+        cache->registered = true;
+    }
+    return cache;
+}
+
+} // namespace
+
+uint8_t* ParcelStorage::allocate(size_t size) {
+    if (size > kMaxCached) return static_cast<uint8_t*>(malloc(size));
+
+    const size_t c = classOf(size);
+    Cache* cache = threadCache();
+    if (cache != nullptr) {
+        if (cache->counts[c] > 0) {
+            cache->stats.hits++;
+            cache->bytes -= classSize(c);
+            return cache->blocks[c][--cache->counts[c]];
+        }
+        cache->stats.misses++;
+    }
+    return static_cast<uint8_t*>(malloc(classSize(c)));
+}
+
+uint8_t* ParcelStorage::reallocate(uint8_t* data, size_t oldSize, size_t newSize) {
+    if (data == nullptr) return allocate(newSize);
+    if (oldSize > kMaxCached && newSize > kMaxCached) {
+        return static_cast<uint8_t*>(realloc(data, newSize));
+    }
+    if (oldSize <= kMaxCached && newSize <= kMaxCached && classOf(oldSize) == classOf(newSize)) {
+        // Still fits the buffer it was given.
+        return data;
+    }
+
+    // Like realloc(), |data| is left alone on failure.
+    uint8_t* newData = allocate(newSize);
+    if (newData == nullptr) return nullptr;
+    memcpy(newData, data, std::min(oldSize, newSize));
+    release(data, oldSize);
+    return newData;
+}
+
+void ParcelStorage::release(uint8_t* data, size_t size) {
+    if (data == nullptr) return;
+    if (size <= kMaxCached) {
+        const size_t c = classOf(size);
+        Cache* cache = threadCache();
+        if (cache != nullptr && cache->counts[c] < kPerClass &&
+            cache->bytes + classSize(c) <= kMaxCachedBytes) {
+            cache->blocks[c][cache->counts[c]++] = data;
+            cache->bytes += classSize(c);
+            return;
+        }
+    }
+    free(data);
+}
+
+ParcelStorage::Stats ParcelStorage::stats() {
+    return tCache.stats;
+}
+
+void ParcelStorage::trim() {
+    trimCache(&tCache);
+}
+
+} // namespace android
@@ -0,0 +1,291 @@
+#define LOG_TAG "ParcelVectors"
+
+#include <binder/ParcelVectors.h>
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace android {
+
+namespace {
+
+// Elements handled per step of a std::vector<bool>, which cannot be
+// accessed as bytes.
+constexpr size_t kBoolChunk = 256;
+
+// Widening and narrowing kernels. Each does what its scalar tail does for
+// every element.
+
+#if defined(__x86_64__)
+
+const bool gHasAvx2 = __builtin_cpu_supports("avx2");
+
+__attribute__((target("avx2"))) size_t widen8Avx2(const uint8_t* src, size_t n, int32_t* dst) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_cvtepu8_epi32(v));
+    }
+    return i;
+}
+
+__attribute__((target("avx2"))) size_t widen16Avx2(const char16_t* src, size_t n,
+                                                   int32_t* dst) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_cvtepu16_epi32(v));
+    }
+    return i;
+}
+
+size_t widen8(const uint8_t* src, size_t n, int32_t* dst) {
+    if (gHasAvx2) return widen8Avx2(src, n, dst);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i lo = _mm_unpacklo_epi8(v, zero);
+        __m128i hi = _mm_unpackhi_epi8(v, zero);
+        __m128i* out = reinterpret_cast<__m128i*>(dst + i);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(lo, zero));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(lo, zero));
+        _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(hi, zero));
+        _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(hi, zero));
+    }
+    return i;
+}
+
+size_t widen16(const char16_t* src, size_t n, int32_t* dst) {
+    if (gHasAvx2) return widen16Avx2(src, n, dst);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i* out = reinterpret_cast<__m128i*>(dst + i);
+        _mm_storeu_si128(out, _mm_unpacklo_epi16(v, zero));
+        _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(v, zero));
+    }
+    return i;
+}
+
+// dst[i] = src[i] != 0
+size_t narrowBool(const int32_t* src, size_t n, uint8_t* dst) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i one = _mm_set1_epi8(1);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        const __m128i* in = reinterpret_cast<const __m128i*>(src + i);
+        __m128i a = _mm_cmpeq_epi32(_mm_loadu_si128(in), zero);
+        __m128i b = _mm_cmpeq_epi32(_mm_loadu_si128(in + 1), zero);
+        __m128i c = _mm_cmpeq_epi32(_mm_loadu_si128(in + 2), zero);
+        __m128i d = _mm_cmpeq_epi32(_mm_loadu_si128(in + 3), zero);
+        // 0xff for zero elements, 0 otherwise.
+        __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_andnot_si128(bytes, one));
+    }
+    return i;
+}
+
+// dst[i] = static_cast<char16_t>(src[i])
+size_t narrow16(const int32_t* src, size_t n, char16_t* dst) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        const __m128i* in = reinterpret_cast<const __m128i*>(src + i);
+        // Sign extending the low half makes the saturating pack exact.
+        __m128i a = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128(in), 16), 16);
+        __m128i b = _mm_srai_epi32(_mm_slli_epi32(_mm_loadu_si128(in + 1), 16), 16);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packs_epi32(a, b));
+    }
+    return i;
+}
+
+#elif defined(__aarch64__)
+
+size_t widen8(const uint8_t* src, size_t n, int32_t* dst) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t v = vmovl_u8(vld1_u8(src + i));
+        uint32_t* out = reinterpret_cast<uint32_t*>(dst + i);
+        vst1q_u32(out, vmovl_u16(vget_low_u16(v)));
+        vst1q_u32(out + 4, vmovl_high_u16(v));
+    }
+    return i;
+}
+
+size_t widen16(const char16_t* src, size_t n, int32_t* dst) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t v = vld1q_u16(reinterpret_cast<const uint16_t*>(src + i));
+        uint32_t* out = reinterpret_cast<uint32_t*>(dst + i);
+        vst1q_u32(out, vmovl_u16(vget_low_u16(v)));
+        vst1q_u32(out + 4, vmovl_high_u16(v));
+    }
+    return i;
+}
+
+size_t narrowBool(const int32_t* src, size_t n, uint8_t* dst) {
+    const uint32_t* in = reinterpret_cast<const uint32_t*>(src);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        // vtst sets all bits of non-zero elements.
+        uint16x8_t mask = vcombine_u16(vmovn_u32(vtstq_u32(vld1q_u32(in + i), vld1q_u32(in + i))),
+                                       vmovn_u32(vtstq_u32(vld1q_u32(in + i + 4),
+                                                           vld1q_u32(in + i + 4))));
+        vst1_u8(dst + i, vand_u8(vmovn_u16(mask), vdup_n_u8(1)));
+    }
+    return i;
+}
+
+size_t narrow16(const int32_t* src, size_t n, char16_t* dst) {
+    const uint32_t* in = reinterpret_cast<const uint32_t*>(src);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t v = vcombine_u16(vmovn_u32(vld1q_u32(in + i)), vmovn_u32(vld1q_u32(in + i + 4)));
+        vst1q_u16(reinterpret_cast<uint16_t*>(dst + i), v);
+    }
+    return i;
+}
+
+#else
+
+size_t widen8(const uint8_t*, size_t, int32_t*) { return 0; }
+size_t widen16(const char16_t*, size_t, int32_t*) { return 0; }
+size_t narrowBool(const int32_t*, size_t, uint8_t*) { return 0; }
+size_t narrow16(const int32_t*, size_t, char16_t*) { return 0; }
+
+#endif
+
+void widenBools(const uint8_t* src, size_t n, int32_t* dst) {
+    for (size_t i = widen8(src, n, dst); i < n; i++) dst[i] = src[i];
+}
+
+void widenChars(const char16_t* src, size_t n, int32_t* dst) {
+    for (size_t i = widen16(src, n, dst); i < n; i++) dst[i] = src[i];
+}
+
+void narrowBools(const int32_t* src, size_t n, uint8_t* dst) {
+    for (size_t i = narrowBool(src, n, dst); i < n; i++) dst[i] = src[i] != 0;
+}
+
+void narrowChars(const int32_t* src, size_t n, char16_t* dst) {
+    for (size_t i = narrow16(src, n, dst); i < n; i++) dst[i] = static_cast<char16_t>(src[i]);
+}
+
+// Writes the count and reserves room for |count| int32 slots.
+int32_t* beginSlots(Parcel* parcel, size_t count, status_t* status) {
+    if (count > static_cast<size_t>(std::numeric_limits<int32_t>::max() / sizeof(int32_t))) {
+        *status = BAD_VALUE;
+        return nullptr;
+    }
+    if ((*status = parcel->writeInt32(static_cast<int32_t>(count))) != OK) return nullptr;
+    auto* slots = static_cast<int32_t*>(parcel->writeInplace(count * sizeof(int32_t)));
+    *status = slots != nullptr ? OK : BAD_VALUE;
+    return slots;
+}
+
+// Reads the count and bounds checks |count| int32 slots.
+const int32_t* readSlots(const Parcel& parcel, size_t* count, status_t* status) {
+    int32_t size;
+    if ((*status = parcel.readInt32(&size)) != OK) return nullptr;
+    if (size < 0) {
+        *status = UNEXPECTED_NULL;
+        return nullptr;
+    }
+    if (static_cast<size_t>(size) > parcel.dataAvail() / sizeof(int32_t)) {
+        *status = BAD_VALUE;
+        return nullptr;
+    }
+    *count = size;
+    auto* slots = static_cast<const int32_t*>(parcel.readInplace(*count * sizeof(int32_t)));
+    *status = slots != nullptr ? OK : BAD_VALUE;
+    return slots;
+}
+
+} // namespace
+
+status_t ParcelVectors::writeBools(Parcel* parcel, const std::vector<bool>& values) {
+    status_t status;
+    int32_t* slots = beginSlots(parcel, values.size(), &status);
+    if (slots == nullptr) return status;
+
+    uint8_t chunk[kBoolChunk];
+    for (size_t i = 0; i < values.size(); i += kBoolChunk) {
+        const size_t n = std::min(kBoolChunk, values.size() - i);
+        std::copy(values.begin() + i, values.begin() + i + n, chunk);
+        widenBools(chunk, n, slots + i);
+    }
+    return OK;
+}
+
+status_t ParcelVectors::writeBools(Parcel* parcel, const bool* values, size_t count) {
+    status_t status;
+    int32_t* slots = beginSlots(parcel, count, &status);
+    if (slots == nullptr) return status;
+    widenBools(reinterpret_cast<const uint8_t*>(values), count, slots);
+    return OK;
+}
+
+status_t ParcelVectors::readBools(const Parcel& parcel, std::vector<bool>* values) {
+    status_t status;
+    size_t count = 0;
+    const int32_t* slots = readSlots(parcel, &count, &status);
+    if (slots == nullptr) return status;
+
+    values->resize(count);
+    uint8_t chunk[kBoolChunk];
+    for (size_t i = 0; i < count; i += kBoolChunk) {
+        const size_t n = std::min(kBoolChunk, count - i);
+        narrowBools(slots + i, n, chunk);
+        std::copy(chunk, chunk + n, values->begin() + i);
+    }
+    return OK;
+}
+
+status_t ParcelVectors::writeChars(Parcel* parcel, const char16_t* values, size_t count) {
+    status_t status;
+    int32_t* slots = beginSlots(parcel, count, &status);
+    if (slots == nullptr) return status;
+    widenChars(values, count, slots);
+    return OK;
+}
+
+status_t ParcelVectors::readChars(const Parcel& parcel, std::vector<char16_t>* values) {
+    status_t status;
+    size_t count = 0;
+    const int32_t* slots = readSlots(parcel, &count, &status);
+    if (slots == nullptr) return status;
+    values->resize(count);
+    narrowChars(slots, count, values->data());
+    return OK;
+}
+
+status_t ParcelVectors::writeRaw(Parcel* parcel, const void* values, size_t count, size_t size) {
+    if (count > static_cast<size_t>(std::numeric_limits<int32_t>::max()) / size) return BAD_VALUE;
+    if (status_t status = parcel->writeInt32(static_cast<int32_t>(count)); status != OK) {
+        return status;
+    }
+    void* dst = parcel->writeInplace(count * size);
+    if (dst == nullptr) return BAD_VALUE;
+    if (count > 0) memcpy(dst, values, count * size);
+    return OK;
+}
+
+status_t ParcelVectors::readRaw(const Parcel& parcel, size_t size, const void** data,
+                                size_t* count) {
+    int32_t n;
+    if (status_t status = parcel.readInt32(&n); status != OK) return status;
+    if (n < 0) return UNEXPECTED_NULL;
+    if (static_cast<size_t>(n) > parcel.dataAvail() / size) return BAD_VALUE;
+    *count = n;
+    *data = parcel.readInplace(*count * size);
+    return *data != nullptr ? OK : BAD_VALUE;
+}
+
+} // namespace android
@@ -0,0 +1,81 @@
+#define LOG_TAG "ParcelViews"
+
+#include <binder/ParcelViews.h>
+
+#include <binder/Parcel.h>
+
+namespace android {
+
+status_t ParcelViews::readElements(const Parcel& parcel, size_t size, const void** data,
+                                   size_t* count) {
+    int32_t length;
+    if (status_t status = parcel.readInt32(&length); status != OK) return status;
+    if (length < 0) return UNEXPECTED_NULL;
+    // Rejects a bogus length before it is multiplied below.
+    if (static_cast<size_t>(length) > parcel.dataAvail() / size) return BAD_VALUE;
+
+    const void* elements = parcel.readInplace(length * size);
+    if (elements == nullptr) return BAD_VALUE;
+    *data = elements;
+    *count = length;
+    return OK;
+}
+
+bool ParcelViews::readNull(const Parcel& parcel) {
+    const size_t position = parcel.dataPosition();
+    int32_t length;
+    if (parcel.readInt32(&length) == OK && length < 0) return true;
+    parcel.setDataPosition(position);
+    return false;
+}
+
+status_t ParcelViews::readBytes(const Parcel& parcel, ParcelSpan<uint8_t>* out) {
+    const void* data;
+    size_t count;
+    if (status_t status = readElements(parcel, 1, &data, &count); status != OK) return status;
+    *out = ParcelSpan<uint8_t>(static_cast<const uint8_t*>(data), count);
+    return OK;
+}
+
+status_t ParcelViews::readBytes(const Parcel& parcel, std::optional<ParcelSpan<uint8_t>>* out) {
+    if (readNull(parcel)) {
+        out->reset();
+        return OK;
+    }
+    ParcelSpan<uint8_t> bytes;
+    if (status_t status = readBytes(parcel, &bytes); status != OK) return status;
+    *out = bytes;
+    return OK;
+}
+
+status_t ParcelViews::readString16(const Parcel& parcel, std::u16string_view* out) {
+    if (readNull(parcel)) return UNEXPECTED_NULL;
+    size_t length;
+    const char16_t* str = parcel.readString16Inplace(&length);
+    if (str == nullptr) return BAD_VALUE;
+    *out = std::u16string_view(str, length);
+    return OK;
+}
+
+status_t ParcelViews::readString16(const Parcel& parcel,
+                                   std::optional<std::u16string_view>* out) {
+    if (readNull(parcel)) {
+        out->reset();
+        return OK;
+    }
+    std::u16string_view str;
+    if (status_t status = readString16(parcel, &str); status != OK) return status;
+    *out = str;
+    return OK;
+}
+
+status_t ParcelViews::readString8(const Parcel& parcel, std::string_view* out) {
+    if (readNull(parcel)) return UNEXPECTED_NULL;
+    size_t length;
+    const char* str = parcel.readString8Inplace(&length);
+    if (str == nullptr) return BAD_VALUE;
+    *out = std::string_view(str, length);
+    return OK;
+}
+
+} // namespace android
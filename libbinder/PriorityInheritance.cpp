@@ -0,0 +1,86 @@
+#define LOG_TAG "PriorityInheritance"
+
+#include <binder/PriorityInheritance.h>
+
+#include <linux/android/binder.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/utsname.h>
+
+#include <atomic>
+
+#include <utils/Log.h>
+
+namespace android {
+
+namespace {
+
+// From the Android common kernel's uapi/linux/android/binder.h.
+constexpr uint32_t kSchedPolicyShift = 9;
+constexpr uint32_t kInheritRt = 0x800;
+
+using Support = PriorityInheritance::Support;
+
+Support detect() {
+    const char* value = getenv("BINDER_PRIORITY_INHERITANCE");
+    if (value != nullptr && *value != '\0') {
+        if (!strcmp(value, "none")) return Support::None;
+        if (!strcmp(value, "nice")) return Support::Nice;
+        if (!strcmp(value, "rt")) return Support::RealTime;
+        ALOGW("Ignoring BINDER_PRIORITY_INHERITANCE=%s", value);
+    }
+
+    utsname name;
+    if (uname(&name) == 0 && strstr(name.release, "-android") != nullptr) {
+        return Support::RealTime;
+    }
+    return Support::Nice;
+}
+
+// Parcels can be flattened from static initializers of other libraries.
+std::atomic<Support>& state() {
+    static std::atomic<Support> support{detect()};
+    return support;
+}
+
+} // namespace
+
+Support PriorityInheritance::support() {
+    return state().load(std::memory_order_relaxed);
+}
+
+void PriorityInheritance::setSupport(Support support) {
+    state().store(support, std::memory_order_relaxed);
+}
+
+const char* PriorityInheritance::toString(Support support) {
+    switch (support) {
+        case Support::None: return "none";
+        case Support::Nice: return "nice";
+        case Support::RealTime: return "rt";
+    }
+    return "unknown";
+}
+
+uint32_t PriorityInheritance::schedPolicyMask(int policy, int priority) {
+    switch (support()) {
+        case Support::None:
+            return 0;
+        case Support::Nice:
+            // Mainline reads the low byte as a minimum nice value and has no
+            // room for a policy, so a real-time minimum cannot be expressed.
+            if (policy != SCHED_OTHER) return 0;
+            return priority & FLAT_BINDER_FLAG_PRIORITY_MASK;
+        case Support::RealTime:
+            return (priority & FLAT_BINDER_FLAG_PRIORITY_MASK) |
+                    ((policy & 3) << kSchedPolicyShift);
+    }
+    return 0;
+}
+
+uint32_t PriorityInheritance::inheritRtFlag() {
+    return support() == Support::RealTime ? kInheritRt : 0;
+}
+
+} // namespace android
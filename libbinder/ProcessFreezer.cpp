@@ -0,0 +1,53 @@
+#define LOG_TAG "ProcessFreezer"
+
+#include <binder/ProcessFreezer.h>
+
+#include <stdint.h>
+
+#include <algorithm>
+
+#include <binder/IPCThreadState.h>
+#include <utils/Log.h>
+
+namespace android {
+
+namespace {
+
+thread_local bool tFrozenReply = false;
+
+} // namespace
+
+status_t ProcessFreezer::freeze(pid_t pid, nsecs_t timeout) {
+    const uint32_t timeoutMs =
+            static_cast<uint32_t>(std::clamp<nsecs_t>(ns2ms(timeout), 0, UINT32_MAX));
+    return IPCThreadState::freeze(pid, true, timeoutMs);
+}
+
+status_t ProcessFreezer::thaw(pid_t pid) {
+    return IPCThreadState::freeze(pid, false, 0);
+}
+
+status_t ProcessFreezer::getFrozenInfo(pid_t pid, FrozenInfo* info) {
+    uint32_t syncReceived = 0, asyncReceived = 0;
+    status_t err = IPCThreadState::getProcessFreezeInfo(pid, &syncReceived, &asyncReceived);
+    if (err != NO_ERROR) return err;
+    // Newer kernels also report pending calls in the upper bits.
+    info->syncReceived = syncReceived & 1;
+    info->asyncReceived = asyncReceived != 0;
+    return NO_ERROR;
+}
+
+bool ProcessFreezer::lastCallHitFrozen() {
+    return tFrozenReply;
+}
+
+void ProcessFreezer::clearFrozenReply() {
+    tFrozenReply = false;
+}
+
+void ProcessFreezer::noteFrozenReply() {
+    tFrozenReply = true;
+    ALOGW("Transaction failed: the target process is frozen (BR_FROZEN_REPLY)");
+}
+
+} // namespace android
@@ -0,0 +1,129 @@
+#define LOG_TAG "ProxyTable"
+
+#include <binder/ProxyTable.h>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include <binder/IBinder.h>
+
+namespace android {
+
+namespace {
+
+struct Entry {
+    IBinder* binder;
+    RefBase::weakref_type* refs;
+};
+
+struct Chunk {
+    std::atomic<Entry*> entries[ProxyTable::kChunkSize] = {};
+};
+
+std::atomic<Chunk*> gChunks[ProxyTable::kMaxHandles / ProxyTable::kChunkSize] = {};
+
+// Lookups in flight, counted per reader slot and per epoch parity. A
+// writer flips the epoch and waits for the count of the old parity to drop
+// to zero; lookups that start after the flip count against the new parity
+// and can no longer see what the writer took out of the table.
+constexpr size_t kReaderSlots = 64;
+
+struct alignas(64) ReaderSlot {
+    std::atomic<uint32_t> active[2] = {};
+};
+
+ReaderSlot gReaders[kReaderSlots];
+std::atomic<uint32_t> gEpoch{0};
+std::atomic<size_t> gNextSlot{0};
+std::mutex gWriteLock;
+
+thread_local const size_t tSlot = gNextSlot.fetch_add(1, std::memory_order_relaxed) % kReaderSlots;
+
+class ReadGuard {
+public:
+    ReadGuard() : mParity(gEpoch.load(std::memory_order_seq_cst) & 1) {
+        gReaders[tSlot].active[mParity].fetch_add(1, std::memory_order_seq_cst);
+    }
+    ~ReadGuard() { gReaders[tSlot].active[mParity].fetch_sub(1, std::memory_order_release); }
+
+private:
+    const uint32_t mParity;
+};
+
+// Waits until no lookup can hold an entry removed before the call.
+// gWriteLock must be held.
+void synchronizeLocked() {
+    const uint32_t parity = gEpoch.fetch_add(1, std::memory_order_seq_cst) & 1;
+    // seq_cst like ReadGuard's increment: either a lookup's count is seen
+    // here, or the lookup sees the entry already taken out.
+    for (const ReaderSlot& slot : gReaders) {
+        while (slot.active[parity].load(std::memory_order_seq_cst) != 0) {
+            std::this_thread::yield();
+        }
+    }
+}
+
+std::atomic<Entry*>* find(int32_t handle) {
+    if (handle <= 0 || static_cast<size_t>(handle) >= ProxyTable::kMaxHandles) return nullptr;
+    Chunk* chunk = gChunks[handle / ProxyTable::kChunkSize].load(std::memory_order_acquire);
+    if (chunk == nullptr) return nullptr;
+    return &chunk->entries[handle % ProxyTable::kChunkSize];
+}
+
+} // namespace
+
+bool ProxyTable::lookup(int32_t handle, sp<IBinder>* out) {
+    RefBase::weakref_type* refs;
+    IBinder* binder;
+    {
+        ReadGuard guard;
+        std::atomic<Entry*>* slot = find(handle);
+        Entry* entry = slot != nullptr ? slot->load(std::memory_order_seq_cst) : nullptr;
+        // A proxy whose weak count dropped to zero is being destroyed;
+        // ProcessState replaces it under its lock.
+        if (entry == nullptr || !entry->refs->attemptIncWeak(out)) return false;
+        refs = entry->refs;
+        binder = entry->binder;
+    }
+    // Our weak reference keeps the proxy alive. Same as ProcessState, this
+    // takes a strong reference even if the last one was just released.
+    out->force_set(binder);
+    refs->decWeak(out);
+    return true;
+}
+
+void ProxyTable::publish(int32_t handle, IBinder* binder, RefBase::weakref_type* refs) {
+    if (handle <= 0 || static_cast<size_t>(handle) >= kMaxHandles) return;
+
+    std::lock_guard<std::mutex> lock(gWriteLock);
+    std::atomic<Chunk*>& chunk = gChunks[handle / kChunkSize];
+    if (chunk.load(std::memory_order_relaxed) == nullptr) {
+        chunk.store(new Chunk(), std::memory_order_release);
+    }
+    Entry* old = chunk.load(std::memory_order_relaxed)->entries[handle % kChunkSize].exchange(
+            new Entry{binder, refs}, std::memory_order_seq_cst);
+    if (old != nullptr) {
+        synchronizeLocked();
+        delete old;
+    }
+}
+
+void ProxyTable::expunge(int32_t handle, IBinder* binder) {
+    std::lock_guard<std::mutex> lock(gWriteLock);
+    Entry* old = nullptr;
+    if (std::atomic<Entry*>* slot = find(handle); slot != nullptr) {
+        Entry* entry = slot->load(std::memory_order_relaxed);
+        if (entry != nullptr && entry->binder == binder) {
+            slot->store(nullptr, std::memory_order_seq_cst);
+            old = entry;
+        }
+    }
+    // If |binder| was already replaced by a newer proxy, publish() waited
+    // for the lookups that could see it.
+    if (old == nullptr) return;
+    synchronizeLocked();
+    delete old;
+}
+
+} // namespace android
@@ -0,0 +1,297 @@
+#define LOG_TAG "ReplyCache"
+
+#include <binder/ReplyCache.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <new>
+
+#include <binder/Binder.h>
+#include <binder/Parcel.h>
+#include <utils/Log.h>
+
+#ifndef F_SEAL_FUTURE_WRITE
+// Missing from older libc headers; kernels before 5.1 reject it.
+#define F_SEAL_FUTURE_WRITE 0x0010
+#endif
+
+namespace android {
+
+// Lives in a sealed memfd that clients map read-only.
+struct ReplyCache::Shared {
+    // Bumped by invalidate() and setCacheable().
+    std::atomic<uint64_t> generation;
+    // Bumped by setCacheable().
+    std::atomic<uint64_t> codesVersion;
+};
+
+namespace {
+
+constexpr int32_t kQueryVersion = 2;
+
+// Key of the state attached to a service with BBinder::attachObject().
+const char kPublishedKey = 0;
+
+struct Published {
+    int fd;
+    ReplyCache::Shared* shared;
+    std::mutex lock;
+    std::vector<uint32_t> codes;
+};
+
+class DeathWatcher : public IBinder::DeathRecipient {
+public:
+    explicit DeathWatcher(std::shared_ptr<std::atomic<bool>> dead) : mDead(std::move(dead)) {}
+
+    void binderDied(const wp<IBinder>& /*who*/) override {
+        mDead->store(true, std::memory_order_release);
+    }
+
+private:
+    const std::shared_ptr<std::atomic<bool>> mDead;
+};
+
+void cleanupPublished(const void* /*id*/, void* object, void* /*cookie*/) {
+    Published* published = static_cast<Published*>(object);
+    munmap(published->shared, sizeof(*published->shared));
+    close(published->fd);
+    delete published;
+}
+
+status_t createPublished(Published** out) {
+    int fd = memfd_create("binder-reply-cache", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0) {
+        ALOGE("memfd_create: %s", strerror(errno));
+        return NO_MEMORY;
+    }
+    const size_t size = sizeof(ReplyCache::Shared);
+    void* map = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) {
+        map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (map == MAP_FAILED) {
+        ALOGE("Cannot map a generation counter: %s", strerror(errno));
+        close(fd);
+        return NO_MEMORY;
+    }
+    // Clients get the fd itself, so the seals are all that keeps them from
+    // writing to the counter or truncating it under the service. Mappings
+    // made before F_SEAL_FUTURE_WRITE, like the service's, stay writable.
+    if (fcntl(fd, F_ADD_SEALS,
+              F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE | F_SEAL_SEAL) != 0) {
+        ALOGE("Cannot seal the generation counter, not publishing it: %s", strerror(errno));
+        munmap(map, size);
+        close(fd);
+        return INVALID_OPERATION;
+    }
+
+    Published* published = new Published();
+    published->fd = fd;
+    published->shared = new (map) ReplyCache::Shared{{0}, {0}};
+    *out = published;
+    return OK;
+}
+
+Published* findPublished(BBinder* service) {
+    return static_cast<Published*>(service->findObject(&kPublishedKey));
+}
+
+} // namespace
+
+status_t ReplyCache::setCacheable(const sp<BBinder>& service,
+                                  const std::vector<uint32_t>& codes) {
+    Published* published = findPublished(service.get());
+    if (published == nullptr) {
+        Published* created;
+        if (status_t err = createPublished(&created); err != OK) return err;
+        published = static_cast<Published*>(
+                service->attachObject(&kPublishedKey, created, nullptr, cleanupPublished));
+        if (published == nullptr) {
+            published = created;
+        } else {
+            // Another thread attached first.
+            cleanupPublished(&kPublishedKey, created, nullptr);
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(published->lock);
+    published->codes = codes;
+    published->shared->codesVersion.fetch_add(1, std::memory_order_release);
+    // Replies cached under the old set of codes may no longer apply.
+    published->shared->generation.fetch_add(1, std::memory_order_release);
+    return OK;
+}
+
+void ReplyCache::invalidate(const sp<BBinder>& service) {
+    if (Published* published = findPublished(service.get()); published != nullptr) {
+        published->shared->generation.fetch_add(1, std::memory_order_release);
+    }
+}
+
+status_t ReplyCache::onQuery(BBinder* service, Parcel* reply) {
+    Published* published = findPublished(service);
+    if (published == nullptr) return UNKNOWN_TRANSACTION;
+    if (reply == nullptr) return BAD_VALUE;
+
+    std::vector<int32_t> codes;
+    uint64_t codesVersion;
+    {
+        std::lock_guard<std::mutex> lock(published->lock);
+        codes.assign(published->codes.begin(), published->codes.end());
+        codesVersion = published->shared->codesVersion.load(std::memory_order_relaxed);
+    }
+    status_t err = reply->writeInt32(kQueryVersion);
+    if (err == OK) err = reply->writeUint64(codesVersion);
+    if (err == OK) err = reply->writeInt32Vector(codes);
+    if (err == OK) err = reply->writeFileDescriptor(published->fd, false /*takeOwnership*/);
+    return err;
+}
+
+ReplyCache::ReplyCache(const sp<IBinder>& binder, size_t maxEntries)
+      : mBinder(binder),
+        mMaxEntries(std::max<size_t>(maxEntries, 1)),
+        mDead(std::make_shared<std::atomic<bool>>(false)) {}
+
+ReplyCache::~ReplyCache() {
+    if (mDeathRecipient != nullptr) {
+        mBinder->unlinkToDeath(mDeathRecipient);
+    }
+    if (mShared != nullptr) {
+        munmap(const_cast<Shared*>(mShared), sizeof(*mShared));
+    }
+}
+
+int ReplyCache::queryCodes(Parcel* reply, std::vector<uint32_t>* codes,
+                           uint64_t* codesVersion) {
+    Parcel data;
+    if (mBinder == nullptr || mBinder->transact(QUERY_TRANSACTION, data, reply) != OK) return -1;
+
+    int32_t version;
+    std::vector<int32_t> list;
+    if (reply->readInt32(&version) != OK || version != kQueryVersion ||
+        reply->readUint64(codesVersion) != OK || reply->readInt32Vector(&list) != OK) {
+        return -1;
+    }
+    codes->assign(list.begin(), list.end());
+    std::sort(codes->begin(), codes->end());
+    return reply->readFileDescriptor();
+}
+
+void ReplyCache::query() {
+    Parcel reply;
+    std::vector<uint32_t> codes;
+    uint64_t codesVersion;
+    int fd = queryCodes(&reply, &codes, &codesVersion);
+    if (fd < 0) return;
+
+    void* map = mmap(nullptr, sizeof(Shared), PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) {
+        ALOGE("Cannot map the generation counter: %s", strerror(errno));
+        return;
+    }
+    if (mBinder->localBinder() == nullptr) {
+        // A dead service no longer bumps the generation.
+        sp<DeathWatcher> watcher = sp<DeathWatcher>::make(mDead);
+        if (mBinder->linkToDeath(watcher) != OK) {
+            munmap(map, sizeof(Shared));
+            return;
+        }
+        mDeathRecipient = watcher;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        mCodes = std::move(codes);
+    }
+    mCodesVersion.store(codesVersion, std::memory_order_relaxed);
+    mShared = static_cast<const Shared*>(map);
+}
+
+void ReplyCache::refreshCodes() {
+    Parcel reply;
+    std::vector<uint32_t> codes;
+    uint64_t codesVersion;
+    if (queryCodes(&reply, &codes, &codesVersion) < 0) return;
+
+    std::lock_guard<std::mutex> lock(mLock);
+    mCodes = std::move(codes);
+    mCodesVersion.store(codesVersion, std::memory_order_relaxed);
+}
+
+bool ReplyCache::isCacheable(uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags) {
+    std::call_once(mQueried, [this] { query(); });
+    if (mShared == nullptr) return false;
+    if (mDead->load(std::memory_order_acquire)) {
+        clear();
+        return false;
+    }
+    if (reply == nullptr || (flags & IBinder::FLAG_ONEWAY) != 0 || data.objectsCount() > 0) {
+        return false;
+    }
+    // The service changed its codes since they were last asked for.
+    if (mShared->codesVersion.load(std::memory_order_acquire) !=
+        mCodesVersion.load(std::memory_order_relaxed)) {
+        refreshCodes();
+    }
+    std::lock_guard<std::mutex> lock(mLock);
+    return std::binary_search(mCodes.begin(), mCodes.end(), code);
+}
+
+status_t ReplyCache::transact(uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags) {
+    if (!isCacheable(code, data, reply, flags)) {
+        return mBinder->transact(code, data, reply, flags);
+    }
+
+    std::string key(reinterpret_cast<const char*>(&code), sizeof(code));
+    key.append(reinterpret_cast<const char*>(data.data()), data.dataSize());
+    // Read before the call: a reply that races an invalidation is stored
+    // as already stale.
+    const uint64_t generation = mShared->generation.load(std::memory_order_acquire);
+    {
+        std::lock_guard<std::mutex> lock(mLock);
+        auto it = mIndex.find(key);
+        if (it != mIndex.end() && it->second->generation == generation) {
+            mEntries.splice(mEntries.begin(), mEntries, it->second);
+            mStats.hits++;
+            return reply->setData(it->second->reply.data(), it->second->reply.size());
+        }
+        mStats.misses++;
+    }
+
+    status_t err = mBinder->transact(code, data, reply, flags);
+    if (err != OK || reply->objectsCount() > 0) return err;
+
+    std::lock_guard<std::mutex> lock(mLock);
+    auto it = mIndex.find(key);
+    if (it != mIndex.end()) {
+        mEntries.splice(mEntries.begin(), mEntries, it->second);
+    } else {
+        mEntries.push_front(Entry{key, 0, {}});
+        mIndex.emplace(std::move(key), mEntries.begin());
+        if (mEntries.size() > mMaxEntries) {
+            mIndex.erase(mEntries.back().key);
+            mEntries.pop_back();
+        }
+    }
+    Entry& entry = mEntries.front();
+    entry.generation = generation;
+    entry.reply.assign(reply->data(), reply->data() + reply->dataSize());
+    return OK;
+}
+
+void ReplyCache::clear() {
+    std::lock_guard<std::mutex> lock(mLock);
+    mEntries.clear();
+    mIndex.clear();
+}
+
+ReplyCache::Stats ReplyCache::stats() const {
+    std::lock_guard<std::mutex> lock(mLock);
+    return mStats;
+}
+
+} // namespace android
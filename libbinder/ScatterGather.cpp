@@ -0,0 +1,74 @@
+#define LOG_TAG "ScatterGather"
+
+#include <binder/ScatterGather.h>
+
+#include <linux/android/binder.h>
+#include <string.h>
+
+#include <binder/Parcel.h>
+
+namespace android {
+
+namespace {
+
+// Calls |fn| with each buffer object in |parcel|.
+template <typename Fn>
+void forEachBuffer(const Parcel& parcel, Fn fn) {
+    const binder_size_t* objects = parcel.ipcObjects();
+    const size_t count = parcel.ipcObjectsCount();
+    for (size_t i = 0; i < count; i++) {
+        binder_object_header hdr;
+        memcpy(&hdr, parcel.data() + objects[i], sizeof(hdr));
+        if (hdr.type != BINDER_TYPE_PTR) continue;
+        binder_buffer_object object;
+        memcpy(&object, parcel.data() + objects[i], sizeof(object));
+        if (!fn(object)) return;
+    }
+}
+
+} // namespace
+
+status_t ScatterGather::writeBuffer(Parcel* parcel, const void* data, size_t size) {
+    if (parcel == nullptr || (data == nullptr && size != 0)) return BAD_VALUE;
+    return parcel->writeBufferObject(data, size);
+}
+
+status_t ScatterGather::readBuffer(const Parcel& parcel, const void** outData, size_t* outSize) {
+    const size_t pos = parcel.dataPosition();
+    if (pos + sizeof(binder_buffer_object) > parcel.dataSize()) return NOT_ENOUGH_DATA;
+
+    // readObject() only returns objects listed in the Parcel's offsets: ones
+    // the driver delivered, or ones written with writeBuffer() when the
+    // Parcel was handed to a local binder.
+    const flat_binder_object* flat = parcel.readObject(true);
+    if (flat == nullptr || flat->hdr.type != BINDER_TYPE_PTR) {
+        parcel.setDataPosition(pos);
+        return BAD_TYPE;
+    }
+    const auto* object = reinterpret_cast<const binder_buffer_object*>(flat);
+    *outData = reinterpret_cast<const void*>(object->buffer);
+    *outSize = object->length;
+    parcel.setDataPosition(pos + sizeof(*object));
+    return NO_ERROR;
+}
+
+bool ScatterGather::hasBuffers(const Parcel& parcel) {
+    bool found = false;
+    forEachBuffer(parcel, [&found](const binder_buffer_object&) {
+        found = true;
+        return false;
+    });
+    return found;
+}
+
+uint64_t ScatterGather::buffersSize(const Parcel& parcel) {
+    uint64_t size = 0;
+    forEachBuffer(parcel, [&size](const binder_buffer_object& object) {
+        // The driver places each buffer at an 8-byte boundary.
+        size += (object.length + 7) & ~static_cast<uint64_t>(7);
+        return true;
+    });
+    return size;
+}
+
+} // namespace android
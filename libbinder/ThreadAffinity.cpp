@@ -0,0 +1,149 @@
+#define LOG_TAG "ThreadAffinity"
+
+#include <binder/ThreadAffinity.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <fstream>
+#include <mutex>
+#include <string>
+
+#include <utils/Log.h>
+
+namespace android {
+
+namespace {
+
+// From <linux/mempolicy.h>, which does not mix well with <sched.h>.
+constexpr int kMpolPreferred = 1;
+
+struct Placement {
+    cpu_set_t cpus;
+    // -1 leaves the memory policy alone.
+    int node;
+};
+
+std::mutex gLock;
+std::vector<Placement> gPlacements;
+std::atomic<size_t> gNext{0};
+std::atomic<bool> gConfigured{false};
+
+bool parseCpuList(const char* list, cpu_set_t* cpus) {
+    CPU_ZERO(cpus);
+    const char* p = list;
+    while (*p != '\0' && *p != '\n') {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0) return false;
+        long last = first;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtol(p, &end, 10);
+            if (end == p || last < first) return false;
+        }
+        for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++) {
+            CPU_SET(cpu, cpus);
+        }
+        p = end;
+        if (*p == ',') p++;
+    }
+    return CPU_COUNT(cpus) > 0;
+}
+
+bool readCpuList(const std::string& path, cpu_set_t* cpus) {
+    std::ifstream file(path);
+    std::string line;
+    return std::getline(file, line) && parseCpuList(line.c_str(), cpus);
+}
+
+void setPlacements(std::vector<Placement> placements) {
+    std::lock_guard<std::mutex> guard(gLock);
+    gPlacements = std::move(placements);
+    gNext.store(0, std::memory_order_relaxed);
+    gConfigured.store(!gPlacements.empty(), std::memory_order_release);
+}
+
+bool initFromEnv() {
+    const char* value = getenv("BINDER_CPUS");
+    if (value == nullptr || *value == '\0') return false;
+
+    status_t err = strcmp(value, "numa") == 0 ? ThreadAffinity::spreadOverNodes()
+                                              : ThreadAffinity::setCpuList(value);
+    ALOGE_IF(err != NO_ERROR, "Ignoring BINDER_CPUS=%s", value);
+    return err == NO_ERROR;
+}
+
+[[maybe_unused]] const bool gAffinityFromEnv = initFromEnv();
+
+} // namespace
+
+status_t ThreadAffinity::setCpus(const cpu_set_t& cpus) {
+    if (CPU_COUNT(&cpus) == 0) return BAD_VALUE;
+    setPlacements({Placement{cpus, -1}});
+    return NO_ERROR;
+}
+
+status_t ThreadAffinity::setCpuList(const char* list) {
+    cpu_set_t cpus;
+    if (list == nullptr || !parseCpuList(list, &cpus)) return BAD_VALUE;
+    return setCpus(cpus);
+}
+
+status_t ThreadAffinity::spreadOverNodes(const std::vector<int>& nodes) {
+    std::vector<int> selected = nodes;
+    if (selected.empty()) {
+        cpu_set_t online;
+        if (!readCpuList("/sys/devices/system/node/online", &online)) return NAME_NOT_FOUND;
+        for (int node = 0; node < CPU_SETSIZE; node++) {
+            if (CPU_ISSET(node, &online)) selected.push_back(node);
+        }
+    }
+
+    std::vector<Placement> placements;
+    for (int node : selected) {
+        Placement placement;
+        placement.node = node;
+        if (!readCpuList("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist",
+                         &placement.cpus)) {
+            ALOGW("Skipping NUMA node %d without CPUs", node);
+            continue;
+        }
+        placements.push_back(placement);
+    }
+    if (placements.empty()) return NAME_NOT_FOUND;
+    setPlacements(std::move(placements));
+    return NO_ERROR;
+}
+
+void ThreadAffinity::clear() {
+    setPlacements({});
+}
+
+void ThreadAffinity::placeCurrentThread() {
+    if (!gConfigured.load(std::memory_order_acquire)) return;
+
+    Placement placement;
+    {
+        std::lock_guard<std::mutex> guard(gLock);
+        if (gPlacements.empty()) return;
+        placement = gPlacements[gNext.fetch_add(1, std::memory_order_relaxed) %
+                                gPlacements.size()];
+    }
+
+    if (sched_setaffinity(0, sizeof(placement.cpus), &placement.cpus) != 0) {
+        ALOGW("Failed to set binder thread affinity: %s", strerror(errno));
+    }
+    if (placement.node >= 0 && placement.node < static_cast<int>(sizeof(unsigned long) * 8)) {
+        unsigned long nodemask = 1ul << placement.node;
+        if (syscall(SYS_set_mempolicy, kMpolPreferred, &nodemask, sizeof(nodemask) * 8 + 1) != 0) {
+            ALOGW("Failed to prefer NUMA node %d: %s", placement.node, strerror(errno));
+        }
+    }
+}
+
+} // namespace android
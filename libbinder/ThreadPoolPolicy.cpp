@@ -0,0 +1,264 @@
+#define LOG_TAG "ThreadPoolPolicy"
+
+#include <binder/ThreadPoolPolicy.h>
+
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <binder/ProcessState.h>
+#include <binder/ThreadAffinity.h>
+#include <utils/Log.h>
+
+namespace android {
+
+namespace {
+
+// How long the reaper waits for a thread it signaled before signaling it
+// again, in case the signal arrived just before the thread entered the
+// driver.
+constexpr nsecs_t kResignalInterval = 20 * 1000000ll;
+
+// A spawned thread, as the reaper sees it.
+struct Idle {
+    pid_t tid = 0;
+    // Whether the thread waits for a command, and since when.
+    bool waiting = false;
+    nsecs_t since = 0;
+    // Set by the reaper to make the thread leave; cleared when the thread
+    // goes back to work instead.
+    std::atomic<bool> requested{false};
+    nsecs_t requestedAt = 0;
+};
+
+std::mutex gLock;
+std::condition_variable gReaperWake;
+ThreadPoolPolicy::Policy gPolicy;
+// Spawned threads in the pool that have not been reaped.
+size_t gThreads = 0;
+size_t gSpawned = 0;
+size_t gReaped = 0;
+nsecs_t gNextSpawn = 0;
+// Spawned threads that may be reaped, and how many of them were asked to go.
+std::vector<Idle*> gMembers;
+size_t gRequested = 0;
+std::once_flag gReaperStarted;
+
+// Copies of gPolicy fields read without gLock on hot paths.
+std::atomic<nsecs_t> gIdleTimeout{0};
+std::atomic<size_t> gStackSize{0};
+
+thread_local bool tReapable = false;
+thread_local bool tReaped = false;
+thread_local Idle tIdle;
+
+void sleepUntil(nsecs_t when) {
+    timespec ts = {static_cast<time_t>(when / 1000000000ll),
+                   static_cast<long>(when % 1000000000ll)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR) {
+    }
+}
+
+int reapSignal() {
+    return SIGRTMAX - 1;
+}
+
+void onReapSignal(int) {
+    // Only here to interrupt BINDER_WRITE_READ; see reapRequested().
+}
+
+// Asks idle threads past the timeout to go, oldest first, and signals them
+// until they do. gLock must be held. Returns when to look again.
+nsecs_t requestReapsLocked(nsecs_t now) {
+    const nsecs_t timeout = gPolicy.idleTimeout;
+    nsecs_t next = now + timeout;
+    std::vector<Idle*> idle;
+    for (Idle* member : gMembers) {
+        if (!member->waiting) continue;
+        if (member->requested.load(std::memory_order_relaxed)) {
+            if (now - member->requestedAt >= kResignalInterval) {
+                member->requestedAt = now;
+                syscall(SYS_tgkill, getpid(), member->tid, reapSignal());
+            }
+            next = std::min(next, member->requestedAt + kResignalInterval);
+        } else if (now - member->since >= timeout) {
+            idle.push_back(member);
+        } else {
+            next = std::min(next, member->since + timeout);
+        }
+    }
+    // The thread that waited longest sits at the end of the driver's list
+    // of waiting threads, so the driver would pick it last anyway.
+    std::sort(idle.begin(), idle.end(), [](Idle* a, Idle* b) { return a->since < b->since; });
+    for (Idle* member : idle) {
+        if (gThreads - gRequested <= gPolicy.minThreads) break;
+        gRequested++;
+        member->requested.store(true, std::memory_order_relaxed);
+        member->requestedAt = now;
+        // Under gLock, so the thread cannot stop waiting unnoticed.
+        syscall(SYS_tgkill, getpid(), member->tid, reapSignal());
+        next = std::min(next, now + kResignalInterval);
+    }
+    return next;
+}
+
+void reaperLoop() {
+    std::unique_lock<std::mutex> lock(gLock);
+    while (true) {
+        if (gPolicy.idleTimeout <= 0) {
+            gReaperWake.wait(lock);
+            continue;
+        }
+        const nsecs_t next = requestReapsLocked(systemTime(SYSTEM_TIME_MONOTONIC));
+        const nsecs_t delay = std::max<nsecs_t>(next - systemTime(SYSTEM_TIME_MONOTONIC), 0);
+        gReaperWake.wait_for(lock, std::chrono::nanoseconds(delay));
+    }
+}
+
+void startReaper() {
+    struct sigaction action = {};
+    action.sa_handler = onReapSignal;
+    // Other calls the signal may catch by accident just go on.
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(reapSignal(), &action, nullptr) != 0) {
+        ALOGE("Failed to install the handler for signal %d: %s", reapSignal(), strerror(errno));
+        return;
+    }
+    std::thread(reaperLoop).detach();
+}
+
+} // namespace
+
+status_t ThreadPoolPolicy::setPolicy(const Policy& policy) {
+    if (policy.idleTimeout > 0 && policy.maxThreads == 0) return BAD_VALUE;
+    if (policy.maxThreads > 0 && policy.minThreads > policy.maxThreads) return BAD_VALUE;
+
+    size_t driverMax;
+    {
+        std::lock_guard<std::mutex> guard(gLock);
+        gPolicy = policy;
+        gIdleTimeout.store(policy.idleTimeout, std::memory_order_relaxed);
+        gStackSize.store(policy.stackSize, std::memory_order_relaxed);
+        driverMax = policy.maxThreads + gReaped;
+    }
+    if (policy.idleTimeout > 0) {
+        std::call_once(gReaperStarted, startReaper);
+        gReaperWake.notify_one();
+    }
+    if (policy.maxThreads > 0) {
+        return ProcessState::self()->setThreadPoolMaxThreadCount(driverMax);
+    }
+    return NO_ERROR;
+}
+
+ThreadPoolPolicy::Policy ThreadPoolPolicy::getPolicy() {
+    std::lock_guard<std::mutex> guard(gLock);
+    return gPolicy;
+}
+
+ThreadPoolPolicy::Stats ThreadPoolPolicy::stats() {
+    std::lock_guard<std::mutex> guard(gLock);
+    Stats stats;
+    stats.threads = gThreads;
+    stats.spawned = gSpawned;
+    stats.reaped = gReaped;
+    return stats;
+}
+
+size_t ThreadPoolPolicy::stackSize() {
+    return gStackSize.load(std::memory_order_relaxed);
+}
+
+ThreadPoolPolicy::Member::Member(bool isMain) : mIsMain(isMain) {
+    // First thing in the pool thread: the top of its stack is already
+    // faulted in, but the deeper pages it faults in serving calls, and
+    // everything it allocates, then come from its node.
+    ThreadAffinity::placeCurrentThread();
+    if (mIsMain) return;
+
+    nsecs_t start;
+    {
+        std::lock_guard<std::mutex> guard(gLock);
+        start = std::max(systemTime(SYSTEM_TIME_MONOTONIC), gNextSpawn);
+        gNextSpawn = start + gPolicy.spawnInterval;
+    }
+    // The driver does not ask for another thread until this one registers,
+    // so holding it back here throttles the whole pool.
+    sleepUntil(start);
+
+    std::lock_guard<std::mutex> guard(gLock);
+    gThreads++;
+    gSpawned++;
+    tReapable = true;
+    tReaped = false;
+    tIdle.tid = static_cast<pid_t>(syscall(SYS_gettid));
+    gMembers.push_back(&tIdle);
+}
+
+ThreadPoolPolicy::Member::~Member() {
+    if (mIsMain) return;
+
+    size_t driverMax = 0;
+    {
+        std::lock_guard<std::mutex> guard(gLock);
+        gMembers.erase(std::find(gMembers.begin(), gMembers.end(), &tIdle));
+        if (tReaped) {
+            gReaped++;
+            driverMax = gPolicy.maxThreads + gReaped;
+        } else {
+            gThreads--;
+        }
+    }
+    tReapable = false;
+    if (driverMax > 0) {
+        // BC_EXIT_LOOPER has been sent; let the driver ask for a
+        // replacement when it runs out of threads.
+        ProcessState::self()->setThreadPoolMaxThreadCount(driverMax);
+    }
+}
+
+bool ThreadPoolPolicy::mayReap() {
+    return tReapable && gIdleTimeout.load(std::memory_order_relaxed) > 0;
+}
+
+bool ThreadPoolPolicy::beginIdle() {
+    if (!mayReap()) return false;
+    std::lock_guard<std::mutex> guard(gLock);
+    tIdle.waiting = true;
+    tIdle.since = systemTime(SYSTEM_TIME_MONOTONIC);
+    return true;
+}
+
+bool ThreadPoolPolicy::endIdle(status_t result) {
+    std::lock_guard<std::mutex> guard(gLock);
+    tIdle.waiting = false;
+    if (!tIdle.requested.load(std::memory_order_relaxed)) return false;
+    tIdle.requested.store(false, std::memory_order_relaxed);
+    gRequested--;
+    // A command arrived first; the thread stays and handles it.
+    if (result != -EINTR) return false;
+
+    gThreads--;
+    tReaped = true;
+    ALOGV("Reaping idle binder thread, %zu left", gThreads);
+    return true;
+}
+
+bool ThreadPoolPolicy::reapRequested() {
+    return tIdle.waiting && tIdle.requested.load(std::memory_order_relaxed);
+}
+
+} // namespace android
@@ -0,0 +1,142 @@
+#define LOG_TAG "TransactionRecorder"
+
+#include <binder/TransactionRecorder.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <binder/Binder.h>
+#include <binder/Parcel.h>
+#include <binder/RecordedTransaction.h>
+#include <utils/Log.h>
+#include <utils/String16.h>
+
+#include "InterfaceToken.h"
+
+namespace android {
+
+using android::base::unique_fd;
+using android::binder::debug::RecordedTransaction;
+
+namespace {
+
+struct Sink {
+    std::mutex lock;
+    unique_fd fd;
+};
+
+struct Capture {
+    // Keeps the binder alive so its address cannot be reused while captured.
+    sp<IBinder> binder;
+    std::shared_ptr<Sink> sink;
+};
+
+std::mutex gLock;
+std::map<const void*, Capture> gCaptures;
+std::shared_ptr<Sink> gProcessSink;
+// Non-zero while anything is captured, checked without gLock on every call.
+std::atomic<int> gActive{0};
+
+bool initFromEnv() {
+    const char* pattern = getenv("BINDER_RECORD");
+    if (pattern == nullptr || *pattern == '\0') return false;
+
+    std::string path;
+    for (const char* p = pattern; *p != '\0'; p++) {
+        if (p[0] == '%' && p[1] == 'p') {
+            path += std::to_string(getpid());
+            p++;
+        } else {
+            path += *p;
+        }
+    }
+
+    unique_fd fd(TEMP_FAILURE_RETRY(
+            open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)));
+    if (!fd.ok()) {
+        ALOGE("Failed to open %s for recording: %s", path.c_str(), strerror(errno));
+        return false;
+    }
+    gProcessSink = std::make_shared<Sink>();
+    gProcessSink->fd = std::move(fd);
+    gActive.fetch_add(1, std::memory_order_relaxed);
+    ALOGI("Recording all transactions to %s", path.c_str());
+    return true;
+}
+
+[[maybe_unused]] const bool gRecordingFromEnv = initFromEnv();
+
+} // namespace
+
+status_t TransactionRecorder::start(const sp<IBinder>& binder, unique_fd fd) {
+    if (binder == nullptr || binder->localBinder() == nullptr) return BAD_TYPE;
+    if (!fd.ok()) return BAD_VALUE;
+
+    auto sink = std::make_shared<Sink>();
+    sink->fd = std::move(fd);
+
+    std::lock_guard<std::mutex> guard(gLock);
+    const void* key = binder->localBinder();
+    bool inserted = gCaptures.insert_or_assign(key, Capture{binder, std::move(sink)}).second;
+    if (inserted) gActive.fetch_add(1, std::memory_order_relaxed);
+    return NO_ERROR;
+}
+
+status_t TransactionRecorder::stop(const sp<IBinder>& binder) {
+    if (binder == nullptr || binder->localBinder() == nullptr) return BAD_TYPE;
+
+    Capture capture;
+    {
+        std::lock_guard<std::mutex> guard(gLock);
+        auto it = gCaptures.find(binder->localBinder());
+        if (it == gCaptures.end()) return NAME_NOT_FOUND;
+        capture = std::move(it->second);
+        gCaptures.erase(it);
+        gActive.fetch_sub(1, std::memory_order_relaxed);
+    }
+    // A transaction that already picked up the sink finishes its write
+    // before the last reference to it goes away here or in record().
+    return NO_ERROR;
+}
+
+void TransactionRecorder::record(const void* target, uint32_t code, uint32_t flags,
+                                 const Parcel& data, const Parcel& reply, status_t err) {
+    if (gActive.load(std::memory_order_relaxed) == 0) return;
+
+    std::shared_ptr<Sink> sink;
+    {
+        std::lock_guard<std::mutex> guard(gLock);
+        auto it = gCaptures.find(target);
+        sink = it != gCaptures.end() ? it->second.sink : gProcessSink;
+    }
+    if (sink == nullptr) return;
+
+    size_t len;
+    const char16_t* descriptor = findInterfaceDescriptor(data, &len);
+    timespec ts;
+    timespec_get(&ts, TIME_UTC);
+    auto transaction = RecordedTransaction::fromDetails(descriptor ? String16(descriptor, len)
+                                                                   : String16(),
+                                                        code, flags, ts, data, reply, err);
+    if (!transaction) {
+        ALOGW("Failed to create RecordedTransaction for code %u", code);
+        return;
+    }
+
+    std::lock_guard<std::mutex> guard(sink->lock);
+    if (status_t status = transaction->dumpToFile(sink->fd); status != NO_ERROR) {
+        ALOGW("Failed to dump RecordedTransaction: %d", status);
+    }
+}
+
+} // namespace android
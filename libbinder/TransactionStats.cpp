@@ -0,0 +1,305 @@
+#define LOG_TAG "TransactionStats"
+
+#include <binder/TransactionStats.h>
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include <binder/Parcel.h>
+#include <utils/String8.h>
+
+#include "InterfaceToken.h"
+
+namespace android {
+
+using Histogram = TransactionStats::Histogram;
+
+namespace {
+
+// Open addressing table size per thread. A thread that talks to more
+// (descriptor, code) pairs than this does not record the extra ones.
+constexpr size_t kSlotsPerThread = 256;
+
+std::atomic<bool> gEnabled{[] {
+    const char* env = getenv("BINDER_TRANSACTION_STATS");
+    return env != nullptr && strcmp(env, "0") != 0;
+}()};
+
+// Histogram that is written by exactly one thread and read by any. The
+// writer uses plain load/store instead of read-modify-write operations, so a
+// sample costs no locked instruction.
+struct AtomicHistogram {
+    std::atomic<uint64_t> counts[Histogram::kBucketCount] = {};
+    std::atomic<uint64_t> count{0};
+    std::atomic<int64_t> sum{0};
+    std::atomic<int64_t> max{0};
+
+    void add(nsecs_t value) {
+        size_t bucket = Histogram::bucketOf(value);
+        counts[bucket].store(counts[bucket].load(std::memory_order_relaxed) + 1,
+                             std::memory_order_relaxed);
+        count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        sum.store(sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        if (value > max.load(std::memory_order_relaxed)) {
+            max.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    void addTo(Histogram* out) const {
+        for (size_t i = 0; i < Histogram::kBucketCount; i++) {
+            out->counts[i] += counts[i].load(std::memory_order_relaxed);
+        }
+        out->count += count.load(std::memory_order_relaxed);
+        out->sum += sum.load(std::memory_order_relaxed);
+        out->max = std::max<nsecs_t>(out->max, max.load(std::memory_order_relaxed));
+    }
+
+    void clear() {
+        for (auto& c : counts) c.store(0, std::memory_order_relaxed);
+        count.store(0, std::memory_order_relaxed);
+        sum.store(0, std::memory_order_relaxed);
+        max.store(0, std::memory_order_relaxed);
+    }
+};
+
+struct SlotData {
+    std::string descriptor;
+    uint32_t code;
+    // The descriptor as it is in the Parcel, UTF-16. Two pairs can share a
+    // key, so a lookup compares this and the code too.
+    std::string rawDescriptor;
+    AtomicHistogram client;
+    AtomicHistogram server;
+
+    bool matches(const uint8_t* raw, size_t rawLen, uint32_t otherCode) const {
+        return code == otherCode && rawDescriptor.size() == rawLen &&
+                (rawLen == 0 || memcmp(rawDescriptor.data(), raw, rawLen) == 0);
+    }
+};
+
+struct Slot {
+    // 0 means empty. Published with release after |data| is set.
+    std::atomic<uint64_t> key{0};
+    std::atomic<SlotData*> data{nullptr};
+};
+
+using EntryKey = std::pair<std::string, uint32_t>;
+
+struct ThreadTable;
+std::mutex gTablesLock;
+std::vector<ThreadTable*>* gTables = nullptr;
+// Totals of threads that already exited, guarded by gTablesLock.
+std::map<EntryKey, TransactionStats::Entry>* gRetired = nullptr;
+
+void addSlotTo(const SlotData& data, std::map<EntryKey, TransactionStats::Entry>* out) {
+    TransactionStats::Entry& entry = (*out)[EntryKey(data.descriptor, data.code)];
+    entry.descriptor = data.descriptor;
+    entry.code = data.code;
+    data.client.addTo(&entry.client);
+    data.server.addTo(&entry.server);
+}
+
+struct ThreadTable {
+    Slot slots[kSlotsPerThread];
+
+    ThreadTable() {
+        std::lock_guard<std::mutex> guard(gTablesLock);
+        if (gTables == nullptr) gTables = new std::vector<ThreadTable*>();
+        gTables->push_back(this);
+    }
+
+    ~ThreadTable() {
+        std::lock_guard<std::mutex> guard(gTablesLock);
+        gTables->erase(std::remove(gTables->begin(), gTables->end(), this), gTables->end());
+        if (gRetired == nullptr) gRetired = new std::map<EntryKey, TransactionStats::Entry>();
+        for (Slot& slot : slots) {
+            SlotData* data = slot.data.load(std::memory_order_acquire);
+            if (data == nullptr) continue;
+            addSlotTo(*data, gRetired);
+            delete data;
+        }
+    }
+
+    SlotData* find(uint64_t key, const uint8_t* descriptor, size_t descriptorLen,
+                   uint32_t code) {
+        for (size_t i = 0; i < kSlotsPerThread; i++) {
+            Slot& slot = slots[(key + i) % kSlotsPerThread];
+            uint64_t current = slot.key.load(std::memory_order_relaxed);
+            if (current == key) {
+                SlotData* data = slot.data.load(std::memory_order_relaxed);
+                if (data->matches(descriptor, descriptorLen, code)) return data;
+            }
+            if (current != 0) continue;
+
+            SlotData* data = new SlotData();
+            data->descriptor = descriptorLen == 0
+                    ? std::string("<unknown>")
+                    : std::string(String8(reinterpret_cast<const char16_t*>(descriptor),
+                                          descriptorLen / sizeof(char16_t))
+                                          .c_str());
+            data->code = code;
+            data->rawDescriptor.assign(reinterpret_cast<const char*>(descriptor), descriptorLen);
+            slot.data.store(data, std::memory_order_release);
+            slot.key.store(key, std::memory_order_release);
+            return data;
+        }
+        return nullptr;
+    }
+};
+
+ThreadTable& threadTable() {
+    static thread_local ThreadTable table;
+    return table;
+}
+
+uint64_t hashKey(const uint8_t* descriptor, size_t len, uint32_t code) {
+    // FNV-1a over the descriptor, then the code.
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ descriptor[i]) * 1099511628211ull;
+    }
+    hash = (hash ^ code) * 1099511628211ull;
+    return hash == 0 ? 1 : hash;
+}
+
+void record(const Parcel& data, uint32_t code, nsecs_t start, bool client) {
+    if (start == 0) return;
+    nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    size_t len;
+    const uint8_t* descriptor =
+            reinterpret_cast<const uint8_t*>(findInterfaceDescriptor(data, &len));
+    len *= sizeof(char16_t);
+    uint64_t key = hashKey(descriptor, len, code);
+    SlotData* slot = threadTable().find(key, descriptor, len, code);
+    if (slot == nullptr) return;
+    (client ? slot->client : slot->server).add(elapsed);
+}
+
+} // namespace
+
+size_t Histogram::bucketOf(nsecs_t value) {
+    if (value < static_cast<nsecs_t>(kSubBuckets)) return value < 0 ? 0 : value;
+    if (value > kMaxValue) value = kMaxValue;
+    size_t exponent = 63 - __builtin_clzll(static_cast<uint64_t>(value));
+    size_t sub = (value >> (exponent - kSubBucketBits)) & (kSubBuckets - 1);
+    return (exponent - kSubBucketBits + 1) * kSubBuckets + sub;
+}
+
+nsecs_t Histogram::bucketUpperBound(size_t bucket) {
+    if (bucket < kSubBuckets) return bucket;
+    size_t exponent = bucket / kSubBuckets + kSubBucketBits - 1;
+    size_t sub = bucket % kSubBuckets;
+    return (static_cast<nsecs_t>(kSubBuckets + sub + 1) << (exponent - kSubBucketBits)) - 1;
+}
+
+nsecs_t Histogram::percentile(double p) const {
+    if (count == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(p * count);
+    if (rank >= count) rank = count - 1;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount; i++) {
+        seen += counts[i];
+        if (seen > rank) return std::min(bucketUpperBound(i), max);
+    }
+    return max;
+}
+
+void Histogram::merge(const Histogram& other) {
+    for (size_t i = 0; i < kBucketCount; i++) {
+        counts[i] += other.counts[i];
+    }
+    count += other.count;
+    sum += other.sum;
+    max = std::max(max, other.max);
+}
+
+void TransactionStats::setEnabled(bool enabled) {
+    gEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool TransactionStats::isEnabled() {
+    return gEnabled.load(std::memory_order_relaxed);
+}
+
+nsecs_t TransactionStats::start() {
+    if (!gEnabled.load(std::memory_order_relaxed)) return 0;
+    return systemTime(SYSTEM_TIME_MONOTONIC);
+}
+
+void TransactionStats::recordClient(const Parcel& data, uint32_t code, nsecs_t start) {
+    record(data, code, start, true);
+}
+
+void TransactionStats::recordServer(const Parcel& data, uint32_t code, nsecs_t start) {
+    record(data, code, start, false);
+}
+
+std::vector<TransactionStats::Entry> TransactionStats::snapshot() {
+    std::map<EntryKey, Entry> merged;
+    {
+        std::lock_guard<std::mutex> guard(gTablesLock);
+        if (gRetired != nullptr) merged = *gRetired;
+        if (gTables != nullptr) {
+            for (ThreadTable* table : *gTables) {
+                for (Slot& slot : table->slots) {
+                    if (slot.key.load(std::memory_order_acquire) == 0) continue;
+                    addSlotTo(*slot.data.load(std::memory_order_acquire), &merged);
+                }
+            }
+        }
+    }
+
+    std::vector<Entry> entries;
+    entries.reserve(merged.size());
+    for (auto& [key, entry] : merged) {
+        entries.push_back(std::move(entry));
+    }
+    return entries;
+}
+
+void TransactionStats::reset() {
+    std::lock_guard<std::mutex> guard(gTablesLock);
+    if (gRetired != nullptr) gRetired->clear();
+    if (gTables == nullptr) return;
+    for (ThreadTable* table : *gTables) {
+        for (Slot& slot : table->slots) {
+            if (slot.key.load(std::memory_order_acquire) == 0) continue;
+            SlotData* data = slot.data.load(std::memory_order_acquire);
+            data->client.clear();
+            data->server.clear();
+        }
+    }
+}
+
+status_t TransactionStats::dump(int fd) {
+    if (!isEnabled()) return NO_ERROR;
+
+    dprintf(fd, "Binder transaction latency (us):\n");
+    dprintf(fd, "  %-48s %6s %6s %10s %8s %8s %8s %8s\n", "descriptor", "code", "side", "count",
+            "p50", "p99", "p999", "max");
+    for (const Entry& entry : snapshot()) {
+        const std::pair<const char*, const Histogram*> sides[] = {
+                {"client", &entry.client},
+                {"server", &entry.server},
+        };
+        for (const auto& [side, h] : sides) {
+            if (h->count == 0) continue;
+            dprintf(fd, "  %-48s %6u %6s %10" PRIu64 " %8.1f %8.1f %8.1f %8.1f\n",
+                    entry.descriptor.c_str(), entry.code, side, h->count,
+                    h->percentile(0.50) / 1e3, h->percentile(0.99) / 1e3,
+                    h->percentile(0.999) / 1e3, h->max / 1e3);
+        }
+    }
+    return NO_ERROR;
+}
+
+} // namespace android
@@ -0,0 +1,342 @@
+#define LOG_TAG "Utf8Transcoder"
+
+#include <binder/Utf8Transcoder.h>
+
+#include <limits.h>
+
+#include <algorithm>
+
+#include <utils/Log.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace android {
+
+namespace {
+
+// Scalar code point helpers, identical to the ones of libutils Unicode.cpp.
+
+inline size_t utf8CodepointLen(uint8_t ch) {
+    return ((0xe5000000 >> ((ch >> 3) & 0x1e)) & 3) + 1;
+}
+
+inline uint32_t utf8ToUtf32Codepoint(const uint8_t* src, size_t length) {
+    uint32_t unicode;
+    switch (length) {
+        case 1:
+            return src[0];
+        case 2:
+            unicode = src[0] & 0x1f;
+            break;
+        case 3:
+            unicode = src[0] & 0x0f;
+            break;
+        case 4:
+            unicode = src[0] & 0x07;
+            break;
+        default:
+            return 0xffff;
+    }
+    for (size_t i = 1; i < length; i++) {
+        unicode = (unicode << 6) | (src[i] & 0x3f);
+    }
+    return unicode;
+}
+
+inline size_t utf32CodepointUtf8Length(char32_t ch) {
+    if (ch < 0x80) return 1;
+    if (ch < 0x800) return 2;
+    if (ch < 0x10000) return (ch < 0xd800 || ch > 0xdfff) ? 3 : 0;
+    return ch <= 0x10ffff ? 4 : 0;
+}
+
+inline void utf32CodepointToUtf8(uint8_t* dst, char32_t ch, size_t bytes) {
+    static constexpr uint8_t kFirstByteMark[] = {0x00, 0x00, 0xc0, 0xe0, 0xf0};
+    if (bytes == 0) return;
+    for (size_t i = bytes - 1; i > 0; i--) {
+        dst[i] = static_cast<uint8_t>((ch | 0x80) & 0xbf);
+        ch >>= 6;
+    }
+    dst[0] = static_cast<uint8_t>(ch | kFirstByteMark[bytes]);
+}
+
+inline bool isSurrogatePair(const char16_t* src, const char16_t* end) {
+    return (src[0] & 0xfc00) == 0xd800 && src + 1 < end && (src[1] & 0xfc00) == 0xdc00;
+}
+
+// ASCII kernels. Each returns how many leading units of |src| (at most |n|)
+// are ASCII; the copy variants also convert those units into |dst|.
+
+#if defined(__x86_64__)
+
+const bool gHasAvx2 = __builtin_cpu_supports("avx2");
+
+size_t asciiPrefix8Sse2(const uint8_t* src, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        int mask = _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+    while (i < n && src[i] < 0x80) i++;
+    return i;
+}
+
+__attribute__((target("avx2"))) size_t asciiPrefix8Avx2(const uint8_t* src, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        uint32_t mask = _mm256_movemask_epi8(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+        if (mask != 0) return i + __builtin_ctz(mask);
+    }
+    return i + asciiPrefix8Sse2(src + i, n - i);
+}
+
+size_t copyAscii8Sse2(const uint8_t* src, size_t n, char16_t* dst) {
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        if (_mm_movemask_epi8(v) != 0) break;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_unpacklo_epi8(v, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i + 8), _mm_unpackhi_epi8(v, zero));
+    }
+    for (; i < n && src[i] < 0x80; i++) dst[i] = src[i];
+    return i;
+}
+
+__attribute__((target("avx2"))) size_t copyAscii8Avx2(const uint8_t* src, size_t n,
+                                                      char16_t* dst) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+        if (_mm256_movemask_epi8(v) != 0) break;
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i),
+                            _mm256_cvtepu8_epi16(_mm256_castsi256_si128(v)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i + 16),
+                            _mm256_cvtepu8_epi16(_mm256_extracti128_si256(v, 1)));
+    }
+    return i + copyAscii8Sse2(src + i, n - i, dst + i);
+}
+
+// Mask of the bytes of non-ASCII units among 8 UTF-16 units.
+inline int nonAscii16Sse2(__m128i v) {
+    const __m128i high = _mm_and_si128(v, _mm_set1_epi16(static_cast<int16_t>(0xff80)));
+    return ~_mm_movemask_epi8(_mm_cmpeq_epi16(high, _mm_setzero_si128())) & 0xffff;
+}
+
+size_t asciiPrefix16Sse2(const char16_t* src, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        int mask = nonAscii16Sse2(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+        if (mask != 0) return i + __builtin_ctz(mask) / 2;
+    }
+    while (i < n && src[i] < 0x80) i++;
+    return i;
+}
+
+size_t copyAscii16Sse2(const char16_t* src, size_t n, char* dst) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 8));
+        if ((nonAscii16Sse2(lo) | nonAscii16Sse2(hi)) != 0) break;
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_packus_epi16(lo, hi));
+    }
+    for (; i < n && src[i] < 0x80; i++) dst[i] = static_cast<char>(src[i]);
+    return i;
+}
+
+inline size_t asciiPrefix8(const uint8_t* src, size_t n) {
+    return gHasAvx2 ? asciiPrefix8Avx2(src, n) : asciiPrefix8Sse2(src, n);
+}
+
+inline size_t copyAscii8(const uint8_t* src, size_t n, char16_t* dst) {
+    return gHasAvx2 ? copyAscii8Avx2(src, n, dst) : copyAscii8Sse2(src, n, dst);
+}
+
+inline size_t asciiPrefix16(const char16_t* src, size_t n) {
+    return asciiPrefix16Sse2(src, n);
+}
+
+inline size_t copyAscii16(const char16_t* src, size_t n, char* dst) {
+    return copyAscii16Sse2(src, n, dst);
+}
+
+#elif defined(__aarch64__)
+
+size_t asciiPrefix8(const uint8_t* src, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n && vmaxvq_u8(vld1q_u8(src + i)) < 0x80; i += 16) {
+    }
+    while (i < n && src[i] < 0x80) i++;
+    return i;
+}
+
+size_t copyAscii8(const uint8_t* src, size_t n, char16_t* dst) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint8x16_t v = vld1q_u8(src + i);
+        if (vmaxvq_u8(v) >= 0x80) break;
+        uint16_t* out = reinterpret_cast<uint16_t*>(dst + i);
+        vst1q_u16(out, vmovl_u8(vget_low_u8(v)));
+        vst1q_u16(out + 8, vmovl_high_u8(v));
+    }
+    for (; i < n && src[i] < 0x80; i++) dst[i] = src[i];
+    return i;
+}
+
+size_t asciiPrefix16(const char16_t* src, size_t n) {
+    const uint16_t* in = reinterpret_cast<const uint16_t*>(src);
+    size_t i = 0;
+    for (; i + 8 <= n && vmaxvq_u16(vld1q_u16(in + i)) < 0x80; i += 8) {
+    }
+    while (i < n && src[i] < 0x80) i++;
+    return i;
+}
+
+size_t copyAscii16(const char16_t* src, size_t n, char* dst) {
+    const uint16_t* in = reinterpret_cast<const uint16_t*>(src);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        uint16x8_t lo = vld1q_u16(in + i);
+        uint16x8_t hi = vld1q_u16(in + i + 8);
+        if (vmaxvq_u16(vorrq_u16(lo, hi)) >= 0x80) break;
+        vst1q_u8(reinterpret_cast<uint8_t*>(dst + i), vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+    }
+    for (; i < n && src[i] < 0x80; i++) dst[i] = static_cast<char>(src[i]);
+    return i;
+}
+
+#else
+
+size_t asciiPrefix8(const uint8_t* src, size_t n) {
+    size_t i = 0;
+    while (i < n && src[i] < 0x80) i++;
+    return i;
+}
+
+size_t copyAscii8(const uint8_t* src, size_t n, char16_t* dst) {
+    size_t i = 0;
+    for (; i < n && src[i] < 0x80; i++) dst[i] = src[i];
+    return i;
+}
+
+size_t asciiPrefix16(const char16_t* src, size_t n) {
+    size_t i = 0;
+    while (i < n && src[i] < 0x80) i++;
+    return i;
+}
+
+size_t copyAscii16(const char16_t* src, size_t n, char* dst) {
+    size_t i = 0;
+    for (; i < n && src[i] < 0x80; i++) dst[i] = static_cast<char>(src[i]);
+    return i;
+}
+
+#endif
+
+} // namespace
+
+ssize_t Utf8Transcoder::utf8ToUtf16Length(const uint8_t* src, size_t srcLen) {
+    size_t i = 0, units = 0;
+    while (i < srcLen) {
+        const size_t ascii = asciiPrefix8(src + i, srcLen - i);
+        i += ascii;
+        units += ascii;
+        if (i == srcLen) break;
+
+        const size_t len = utf8CodepointLen(src[i]);
+        // Malformed, the code point runs past the end.
+        if (len > srcLen - i) return -1;
+        units += utf8ToUtf32Codepoint(src + i, len) > 0xffff ? 2 : 1;
+        i += len;
+    }
+    return units;
+}
+
+char16_t* Utf8Transcoder::utf8ToUtf16(const uint8_t* src, size_t srcLen, char16_t* dst,
+                                      size_t dstLen) {
+    LOG_ALWAYS_FATAL_IF(dstLen == 0 || dstLen > SSIZE_MAX, "dstLen is %zu", dstLen);
+    const char16_t* const end = dst + dstLen - 1;
+    char16_t* cur = dst;
+    size_t i = 0;
+    while (i < srcLen && cur < end) {
+        const size_t ascii = copyAscii8(src + i, std::min<size_t>(srcLen - i, end - cur), cur);
+        i += ascii;
+        cur += ascii;
+        if (i == srcLen || cur == end) break;
+
+        const size_t len = utf8CodepointLen(src[i]);
+        if (len > srcLen - i) break;
+        uint32_t codepoint = utf8ToUtf32Codepoint(src + i, len);
+        if (codepoint <= 0xffff) {
+            *cur++ = static_cast<char16_t>(codepoint);
+        } else {
+            codepoint -= 0x10000;
+            // No room for the pair: drop it, as libutils does.
+            if (end - cur < 2) break;
+            *cur++ = static_cast<char16_t>((codepoint >> 10) + 0xd800);
+            *cur++ = static_cast<char16_t>((codepoint & 0x3ff) + 0xdc00);
+        }
+        i += len;
+    }
+    *cur = 0;
+    return cur;
+}
+
+ssize_t Utf8Transcoder::utf16ToUtf8Length(const char16_t* src, size_t srcLen) {
+    if (src == nullptr || srcLen == 0) return -1;
+
+    const char16_t* const end = src + srcLen;
+    size_t bytes = 0;
+    while (src < end) {
+        const size_t ascii = asciiPrefix16(src, end - src);
+        src += ascii;
+        bytes += ascii;
+        if (src == end) break;
+
+        if (isSurrogatePair(src, end)) {
+            bytes += 4;
+            src += 2;
+        } else {
+            bytes += utf32CodepointUtf8Length(*src++);
+        }
+    }
+    // Cannot overflow: every unit takes at most 3 bytes.
+    return bytes;
+}
+
+void Utf8Transcoder::utf16ToUtf8(const char16_t* src, size_t srcLen, char* dst, size_t dstLen) {
+    if (src == nullptr || srcLen == 0 || dst == nullptr) return;
+
+    const char16_t* const end = src + srcLen;
+    char* cur = dst;
+    while (src < end) {
+        const size_t ascii = copyAscii16(src, std::min<size_t>(end - src, dstLen), cur);
+        src += ascii;
+        cur += ascii;
+        dstLen -= ascii;
+        if (src == end) break;
+
+        char32_t utf32;
+        if (isSurrogatePair(src, end)) {
+            utf32 = ((src[0] - 0xd800) << 10 | (src[1] - 0xdc00)) + 0x10000;
+            src += 2;
+        } else {
+            utf32 = *src++;
+        }
+        const size_t len = utf32CodepointUtf8Length(utf32);
+        LOG_ALWAYS_FATAL_IF(dstLen < len, "%zu < %zu", dstLen, len);
+        utf32CodepointToUtf8(reinterpret_cast<uint8_t*>(cur), utf32, len);
+        cur += len;
+        dstLen -= len;
+    }
+    LOG_ALWAYS_FATAL_IF(dstLen < 1, "dst_len < 1: %zu < 1", dstLen);
+    *cur = '\0';
+}
+
+} // namespace android
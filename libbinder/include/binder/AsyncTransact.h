@@ -0,0 +1,129 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if __cplusplus >= 202002L && __has_include(<coroutine>)
+#include <coroutine>
+#define BINDER_HAS_COROUTINES 1
+#endif
+
+#include <binder/IBinder.h>
+#include <utils/Errors.h>
+#include <utils/StrongPointer.h>
+
+namespace android {
+
+class Parcel;
+
+/**
+ * Threads that make blocking binder calls on behalf of other threads.
+ *
+ * The driver delivers a reply to the thread that sent the transaction, so a
+ * call in flight always occupies a thread. TransactWorkers takes that
+ * thread out of the caller: an event loop hands calls over and is told when
+ * they complete, and the calls in flight are bounded by the pool instead of
+ * by the number of callers. Works the same for RPC binder proxies.
+ */
+class TransactWorkers {
+public:
+    // Runs a function somewhere, e.g. the post() of an event loop.
+    using Executor = std::function<void(std::function<void()>)>;
+    using Callback = std::function<void(status_t)>;
+
+    explicit TransactWorkers(size_t threads);
+    // Waits for the calls already handed over.
+    ~TransactWorkers();
+
+    TransactWorkers(const TransactWorkers&) = delete;
+    TransactWorkers& operator=(const TransactWorkers&) = delete;
+
+    // Process wide pool of BINDER_TRANSACT_WORKERS threads (default 4),
+    // started on first use.
+    static TransactWorkers& shared();
+
+    size_t threads() const { return mThreads.size(); }
+
+    // Runs |binder|->transact() on a worker and calls |done| there with the
+    // result. |data| and |reply| must stay valid until then.
+    void transact(const sp<IBinder>& binder, uint32_t code, const Parcel& data, Parcel* reply,
+                  uint32_t flags, Callback done);
+
+    void post(std::function<void()> work);
+
+private:
+    void threadLoop();
+
+    std::mutex mLock;
+    std::condition_variable mCond;
+    std::deque<std::function<void()>> mQueue;
+    bool mStopping = false;
+    std::vector<std::thread> mThreads;
+};
+
+#ifdef BINDER_HAS_COROUTINES
+
+/**
+ * IBinder::transact() for coroutines (C++20, BINDER_CXX20=ON).
+ *
+ *     Parcel data, reply;
+ *     data.writeInterfaceToken(descriptor);
+ *     status_t err = co_await AsyncTransact(binder, CODE, data, &reply, 0, loop.executor());
+ *
+ * The call runs on a TransactWorkers thread and the coroutine is resumed
+ * through |resume|, or on the worker when there is none. |data| and |reply|
+ * must outlive the co_await, which locals of the coroutine do.
+ */
+class AsyncTransact {
+public:
+    AsyncTransact(sp<IBinder> binder, uint32_t code, const Parcel& data, Parcel* reply,
+                  uint32_t flags = 0, TransactWorkers::Executor resume = nullptr,
+                  TransactWorkers& workers = TransactWorkers::shared())
+          : mBinder(std::move(binder)),
+            mCode(code),
+            mData(data),
+            mReply(reply),
+            mFlags(flags),
+            mResume(std::move(resume)),
+            mWorkers(workers) {}
+
+    bool await_ready() const noexcept { return mBinder == nullptr; }
+
+    void await_suspend(std::coroutine_handle<> handle) {
+        mWorkers.transact(mBinder, mCode, mData, mReply, mFlags, [this, handle](status_t err) {
+            mResult = err;
+            // The coroutine frame, and this with it, may be gone as soon as
+            // it is resumed.
+            TransactWorkers::Executor resume = std::move(mResume);
+            if (resume) {
+                resume([handle] { handle.resume(); });
+            } else {
+                handle.resume();
+            }
+        });
+    }
+
+    status_t await_resume() const noexcept { return mBinder == nullptr ? BAD_VALUE : mResult; }
+
+private:
+    const sp<IBinder> mBinder;
+    const uint32_t mCode;
+    const Parcel& mData;
+    Parcel* const mReply;
+    const uint32_t mFlags;
+    TransactWorkers::Executor mResume;
+    TransactWorkers& mWorkers;
+    status_t mResult = UNKNOWN_ERROR;
+};
+
+#endif // BINDER_HAS_COROUTINES
+
+} // namespace android
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+/**
+ * Size of the binder buffer and how full it gets.
+ *
+ * Every process maps a buffer from the driver into which the driver copies
+ * incoming transactions; half of it is reserved for oneway calls. It used
+ * to be a fixed 1MB minus two pages. vmSize() now comes from setVmSize() or
+ * BINDER_VM_SIZE (bytes, or with a K or M suffix), so a bulk-data service
+ * can map up to the driver's limit of 4MB and a small helper much less.
+ * The size is fixed once ProcessState maps the driver.
+ *
+ * stats() tells how the buffer is used: the received buffers this process
+ * holds and their high-water mark, failed transactions, and what the
+ * driver reports for the process in binder_logs/stats (-1 where it is not
+ * readable).
+ */
+class BufferUsage {
+public:
+    struct Stats {
+        size_t vmSize = 0;
+
+        // Received transactions whose buffers were not freed yet.
+        size_t buffers = 0;
+        size_t bytes = 0;
+        size_t maxBuffers = 0;
+        size_t maxBytes = 0;
+
+        // Calls from this process that failed with BR_FAILED_REPLY, and of
+        // those the ones the receiver had no buffer space for.
+        uint64_t failedReplies = 0;
+        uint64_t allocationFailures = 0;
+
+        // Reported by the driver.
+        int64_t driverBuffers = -1;
+        int64_t freeAsyncSpace = -1;
+        int64_t pagesActive = -1;
+        int64_t pagesHighWatermark = -1;
+    };
+
+    static size_t vmSize();
+    // Returns false if ProcessState already mapped the driver.
+    static bool setVmSize(size_t bytes);
+    // Used by ProcessState to map the driver. Returns vmSize() and fixes it.
+    static size_t mapSize();
+
+    static Stats stats();
+    // Restarts the high-water marks at the current use.
+    static void resetHighWatermark();
+
+    // Used by IPCThreadState.
+    //
+    // A transaction buffer was received or freed.
+    static void noteReceived(size_t dataSize, size_t objectsCount);
+    static void noteFreed(size_t dataSize, size_t objectsCount);
+    // A transaction starts, or the driver answered it with
+    // BR_FAILED_REPLY.
+    static void clearFailedReply();
+    static void noteFailedReply(int driverFd);
+    // Whether the current transaction got BR_FAILED_REPLY. |error| is the
+    // reason the driver gave, or 0 on kernels before 6.0 that cannot tell.
+    static bool lastFailedReply(int* error);
+};
+
+} // namespace android
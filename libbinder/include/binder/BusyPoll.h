@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <utils/Timers.h>
+
+namespace android {
+
+/**
+ * Busy-poll mode for binder threads.
+ *
+ * When enabled, a thread of the pool that runs out of commands polls the
+ * binder fd for a while before blocking in BINDER_WRITE_READ, which saves
+ * the scheduler wake-up on services that get calls back to back. Meant for
+ * threads that own a core; spinning steals CPU time from anything else.
+ *
+ * The spin budget follows the arrival rate seen by each thread: about twice
+ * the average idle time between commands, within [minSpin, maxSpin]. When
+ * commands arrive further apart than maxSpin, threads only spin for minSpin.
+ * A minSpin above maxSpin is swapped with it.
+ *
+ * A spinning thread is outside the driver, so the driver does not count it
+ * among the threads waiting for work: when another thread takes a command
+ * and no thread is left waiting, the driver asks for a new looper with
+ * BR_SPAWN_LOOPER. To keep the pool from growing with every wake-up, only
+ * one thread of the process spins at a time; the others block in the
+ * driver right away.
+ *
+ * Starting a process with BINDER_BUSY_POLL=<max us>[,<min us>] enables it
+ * as well.
+ */
+class BusyPoll {
+public:
+    struct Policy {
+        nsecs_t minSpin = 0;
+        // 0 disables busy polling.
+        nsecs_t maxSpin = 0;
+    };
+
+    struct Stats {
+        // Waits that started with a spin.
+        uint64_t spins = 0;
+        // Spins that found a command before the budget ran out.
+        uint64_t hits = 0;
+    };
+
+    static void setPolicy(const Policy& policy);
+    static Policy getPolicy();
+    static bool isEnabled();
+
+    static Stats stats();
+
+    // Called by IPCThreadState::getAndExecuteCommand() around the talk to
+    // the driver when the thread has nothing left to execute.
+    static void spin(int fd);
+    static void woke();
+};
+
+} // namespace android
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include <utils/Errors.h>
+
+namespace android {
+
+class Parcel;
+
+/**
+ * Corks the oneway transactions of the calling thread.
+ *
+ * While an OnewayBatch is alive, IPCThreadState::transact() queues oneway
+ * transactions instead of talking to the driver for each of them. They are
+ * sent, to one target or many, with a single BINDER_WRITE_READ when the
+ * outermost batch goes out of scope, when flush() is called or when the
+ * batch reaches its limits.
+ *
+ *     {
+ *         OnewayBatch batch;
+ *         for (const auto& event : events) listener->onEvent(event);
+ *         status_t err = batch.flush();
+ *     }
+ *
+ * The payload of every queued call is copied, so callers may destroy their
+ * Parcels right away. A two-way call made on the thread while transactions
+ * are queued flushes them first to keep their results apart. Errors of
+ * queued calls are reported by flush(); the destructor drops them. A
+ * failed call, e.g. to a dead or full receiver, does not affect the calls
+ * queued behind it.
+ *
+ * Batches nest; only the outermost one flushes on destruction. Batching is
+ * per thread and an OnewayBatch must be destroyed on the thread that
+ * created it.
+ */
+class OnewayBatch {
+public:
+    struct Limits {
+        // Queued transactions that trigger a flush.
+        size_t maxTransactions = 1024;
+        // Queued payload bytes that trigger a flush.
+        size_t maxBytes = 256 * 1024;
+    };
+
+    OnewayBatch();
+    // |limits| only take effect for the outermost batch.
+    explicit OnewayBatch(const Limits& limits);
+    ~OnewayBatch();
+
+    OnewayBatch(const OnewayBatch&) = delete;
+    OnewayBatch& operator=(const OnewayBatch&) = delete;
+
+    // Sends everything queued on this thread and returns the first error of
+    // any queued call since the last flush().
+    status_t flush();
+
+    // Number of transactions queued on the calling thread.
+    static size_t pending();
+
+    // Used by IPCThreadState.
+    //
+    // When the thread is corked, copies |data| into the batch and returns the
+    // copy to hand to the driver instead of |data|. Returns nullptr when the
+    // call must be sent right away.
+    static const Parcel* defer(const Parcel& data);
+    // Marks the transaction last returned by defer(), to |handle|, as
+    // written to mOut.
+    static void commit(int32_t handle);
+    // Whether the queue reached its limits and must be flushed now.
+    static bool full();
+    // Takes the targets of the queued transactions, in the order the driver
+    // answers them, and starts the flush.
+    static std::vector<int32_t> takePending();
+    // Frees the queued payloads once the driver has copied them, ending the
+    // flush.
+    static void releaseParcels();
+    static void recordError(status_t err);
+    // Whether the calling thread is between takePending() and
+    // releaseParcels().
+    static bool flushing();
+    // During a flush, the driver stops reading mOut at the first transaction
+    // that fails, leaving the calls queued behind it. Drops the |written|
+    // bytes it did read from |out| and keeps the rest for the next talk.
+    static void dropWritten(Parcel* out, size_t written);
+};
+
+} // namespace android
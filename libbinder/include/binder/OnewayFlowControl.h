@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+
+#include <binder/IBinder.h>
+#include <utils/Errors.h>
+#include <utils/StrongPointer.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+class Parcel;
+
+/**
+ * Flow control for oneway senders.
+ *
+ * The driver tells a sender about a receiver that cannot keep up in two
+ * ways: BR_ONEWAY_SPAM_SUSPECT once the receiver's async buffer space runs
+ * low, and a failed transaction once it is exhausted. IPCThreadState
+ * reports both here, per target proxy. The driver only sends the first to
+ * senders with spam detection on, which ProcessState enables by default;
+ * a sender that called ProcessState::enableOnewaySpamDetection(false) only
+ * sees failed transactions.
+ *
+ *     OnewayFlowControl::setListener([](const sp<IBinder>& target, Pressure p) {
+ *         ALOGW("%s is falling behind", ...);
+ *     });
+ *     ...
+ *     status_t err = OnewayFlowControl::send(listener, CODE_EVENT, data,
+ *                                            OnewayFlowControl::Mode::Blocking, ms2ns(100));
+ *
+ * send() turns a full receiver into WOULD_BLOCK (NonBlocking) or retries
+ * with backoff until the receiver has drained enough (Blocking). In
+ * Blocking mode it also paces calls to a spam suspect.
+ */
+class OnewayFlowControl {
+public:
+    enum class Pressure {
+        None,
+        // The receiver's async space is running low.
+        SpamSuspect,
+        // The receiver's async space is exhausted; calls fail.
+        Full,
+    };
+
+    enum class Mode {
+        NonBlocking,
+        Blocking,
+    };
+
+    // Called on the sending thread whenever a target enters a new state,
+    // including Pressure::None once it recovers.
+    using Listener = std::function<void(const sp<IBinder>& target, Pressure pressure)>;
+    static void setListener(Listener listener);
+
+    // Last state reported for |target|.
+    static Pressure pressure(const sp<IBinder>& target);
+
+    // Sends a oneway transaction. With NonBlocking, returns WOULD_BLOCK
+    // without having delivered |data| when the receiver is full. With
+    // Blocking, retries until it is delivered or |timeout| (negative: no
+    // limit) passes, then returns TIMED_OUT.
+    static status_t send(const sp<IBinder>& target, uint32_t code, const Parcel& data,
+                         Mode mode, nsecs_t timeout = -1);
+
+    // Used by IPCThreadState.
+    //
+    // The driver answered the current oneway call with
+    // BR_ONEWAY_SPAM_SUSPECT.
+    static void noteSpamSuspect();
+    // A oneway call to |handle| completed with |err|.
+    static void onOnewaySent(int32_t handle, status_t err);
+};
+
+} // namespace android
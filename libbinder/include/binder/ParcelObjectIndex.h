@@ -0,0 +1,44 @@
+#pragma once
+
+#include <linux/android/binder.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+/**
+ * Keeps the object offsets of a Parcel usable as a sorted index.
+ *
+ * Every read from a Parcel that carries binders or file descriptors is
+ * checked against the offsets of its objects, starting at a hint that
+ * follows the read position. setDataPosition() used to reset that hint and
+ * forget that the offsets were sorted, so the next read sorted and walked
+ * all of them again. Generated code calls setDataPosition() after every
+ * parcelable, which made reading a list of parcelables holding binders
+ * quadratic in their number.
+ *
+ * Parcel now only forgets the order when an object is written in front of
+ * another one, and a new position finds its hint with a binary search, so
+ * sequential reads cost O(1) and a seek O(log n).
+ */
+class ParcelObjectIndex {
+public:
+    // Size of the object at |offset| in |data|: binder_buffer_object for
+    // BINDER_TYPE_PTR, flat_binder_object otherwise.
+    static size_t objectSize(const uint8_t* data, binder_size_t offset);
+
+    // Index of the first object in |data| that ends after |position|, or
+    // |count|. |objects| must be sorted.
+    static size_t seek(const uint8_t* data, const binder_size_t* objects, size_t count,
+                       size_t position);
+
+    // Sorts |objects| unless it already is.
+    static void sort(binder_size_t* objects, size_t count);
+
+    // Called before an object at |offset| is appended to |objects|. Clears
+    // |sorted| if that breaks the order.
+    static void noteAppend(const binder_size_t* objects, size_t count, binder_size_t offset,
+                           bool* sorted);
+};
+
+} // namespace android
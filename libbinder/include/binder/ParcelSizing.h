@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <utils/Errors.h>
+
+namespace android {
+
+class Parcel;
+class Parcelable;
+
+/**
+ * Sizes a Parcel up front for the parcelable about to be written into it.
+ *
+ * A Parcel grows by half of its size whenever a write does not fit, so a
+ * large structured parcelable such as one with nested parcelables and
+ * vectors costs several reallocations and copies per call. Reserving the
+ * final size before writing makes it one allocation:
+ *
+ *     Parcel data;
+ *     data.writeInterfaceToken(descriptor);
+ *     ParcelSizing::writeParcelable(&data, bigParcelable);
+ *
+ * The size comes from what the same parcelable type took the last times it
+ * was written on this thread, which is exact for fixed shapes and close for
+ * most others; the first write of a type is not sized. sizeOf() measures a
+ * value exactly instead, at the cost of serializing it once more.
+ */
+class ParcelSizing {
+public:
+    // Bytes |value|.writeToParcel() writes.
+    static size_t sizeOf(const Parcelable& value);
+
+    // Makes room for |bytes| more bytes at the current position.
+    static status_t reserve(Parcel* parcel, size_t bytes);
+
+    // value.writeToParcel(parcel), with the capacity reserved first.
+    static status_t write(Parcel* parcel, const Parcelable& value);
+    // Same as Parcel::writeParcelable(), with the capacity reserved first.
+    static status_t writeParcelable(Parcel* parcel, const Parcelable& value);
+};
+
+} // namespace android
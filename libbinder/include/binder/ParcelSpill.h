@@ -0,0 +1,70 @@
+#pragma once
+
+#include <linux/android/binder.h>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+class Parcel;
+
+/**
+ * Moves oversized transactions into shared memory.
+ *
+ * The driver copies transaction data into the receiver's binder mapping,
+ * which is about 1MB for the whole process, so a large Parcel fails with
+ * FAILED_TRANSACTION (TRANSACTION_TOO_LARGE) and a merely big one leaves
+ * little room for other calls. IPCThreadState therefore sends a Parcel above
+ * threshold() as a sealed memfd holding its data, and the receiving side
+ * maps that memfd back in place of the transaction data before the Parcel
+ * reaches onTransact() or the caller of transact(). Neither side sees the
+ * difference.
+ *
+ * Parcels carrying binders, file descriptors or scatter-gather buffers
+ * are sent as they are, since the driver has to translate their objects.
+ * Both processes must use this library. The threshold comes from
+ * BINDER_SPILL_THRESHOLD (bytes, 0 disables spilling) and defaults to
+ * 256KiB.
+ */
+class ParcelSpill {
+public:
+    // Release function of a transaction buffer, as Parcel::ipcSetDataReference()
+    // takes it.
+    using ReleaseFunc = void (*)(const uint8_t* data, size_t dataSize,
+                                 const binder_size_t* objects, size_t objectsSize);
+
+    static size_t threshold();
+    static void setThreshold(size_t bytes);
+
+    // Called by IPCThreadState before sending |data|. Returns the Parcel to
+    // send in its place, or nullptr to send |data| itself. The Parcel stays
+    // valid until release() or the next spill() on the same thread.
+    static const Parcel* spill(const Parcel& data);
+    static void release();
+
+    // Calls release() when the transaction that may have spilled goes out of
+    // scope, on every return path.
+    class ReleaseGuard {
+    public:
+        ReleaseGuard() = default;
+        ~ReleaseGuard() { release(); }
+        ReleaseGuard(const ReleaseGuard&) = delete;
+        ReleaseGuard& operator=(const ReleaseGuard&) = delete;
+    };
+
+    // Called by IPCThreadState on a received reply. If it carries spilled
+    // data, maps that data and returns true; the mapping is handed to
+    // Parcel::ipcSetDataReference() with unmap() as its release function.
+    static bool map(const Parcel& parcel, const uint8_t** outData, size_t* outSize);
+    // Called by IPCThreadState on a received transaction before it is wrapped
+    // in a Parcel. Like map(), but the transaction buffer is kept until the
+    // mapping is released, and then released with |release|: freeing the
+    // buffer of a oneway call lets the driver dispatch the next oneway call
+    // to the same node, which must wait until this one is done.
+    static bool map(const binder_transaction_data& tr, ReleaseFunc release,
+                    const uint8_t** outData, size_t* outSize);
+    static void unmap(const uint8_t* data, size_t dataSize, const binder_size_t* objects,
+                      size_t objectsSize);
+};
+
+} // namespace android
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+/**
+ * Allocator behind the data buffer of every Parcel.
+ *
+ * Buffers up to kMaxCached bytes are handed out in power of two size
+ * classes and, once released, kept in a cache of the releasing thread
+ * instead of going back to malloc. A thread that keeps making similar
+ * calls therefore reuses the same few buffers for its data and reply
+ * Parcels, and growing a Parcel within its size class costs nothing.
+ * Larger buffers use malloc/realloc directly.
+ *
+ * Each thread caches at most kMaxCachedBytes. BINDER_PARCEL_CACHE=0
+ * disables the cache.
+ */
+class ParcelStorage {
+public:
+    static constexpr size_t kMinSize = 64;
+    static constexpr size_t kMaxCached = 64 * 1024;
+    static constexpr size_t kMaxCachedBytes = 256 * 1024;
+
+    struct Stats {
+        // Buffers served from the cache of the calling thread.
+        uint64_t hits = 0;
+        // Buffers that had to be allocated.
+        uint64_t misses = 0;
+    };
+
+    // Sizes are the capacities the Parcel asked for; release() and
+    // reallocate() must be given the last one of that buffer.
+    static uint8_t* allocate(size_t size);
+    static uint8_t* reallocate(uint8_t* data, size_t oldSize, size_t newSize);
+    static void release(uint8_t* data, size_t size);
+
+    // Counters of the calling thread.
+    static Stats stats();
+    // Frees the buffers cached by the calling thread.
+    static void trim();
+};
+
+} // namespace android
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <type_traits>
+#include <vector>
+
+#include <binder/Parcel.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+/**
+ * Bulk (de)serialization of primitive arrays.
+ *
+ * bool and char16_t elements take an int32 slot each on the wire. Instead
+ * of one writeInt32()/readInt32() per element, the whole array is reserved
+ * or bounds checked once and widened or narrowed with SIMD (SSE2/AVX2 on
+ * x86-64, NEON on arm64). Parcel::writeBoolVector(), readBoolVector(),
+ * writeCharVector() and readCharVector() use these.
+ *
+ * int32, int64, float and double arrays are laid out on the wire as in
+ * memory; writeArray()/readArray() move them with one memcpy, also from
+ * and into plain buffers so that large arrays need not be copied into a
+ * std::vector first.
+ *
+ * The format is that of Parcel: an int32 element count, then the elements.
+ */
+class ParcelVectors {
+public:
+    static status_t writeBools(Parcel* parcel, const std::vector<bool>& values);
+    static status_t writeBools(Parcel* parcel, const bool* values, size_t count);
+    static status_t readBools(const Parcel& parcel, std::vector<bool>* values);
+
+    static status_t writeChars(Parcel* parcel, const char16_t* values, size_t count);
+    static status_t writeChars(Parcel* parcel, const std::vector<char16_t>& values) {
+        return writeChars(parcel, values.data(), values.size());
+    }
+    static status_t readChars(const Parcel& parcel, std::vector<char16_t>* values);
+
+    template <typename T>
+    static constexpr bool kIsMemcpyable = std::is_same_v<T, int32_t> ||
+            std::is_same_v<T, int64_t> || std::is_same_v<T, uint64_t> ||
+            std::is_same_v<T, float> || std::is_same_v<T, double>;
+
+    template <typename T, std::enable_if_t<kIsMemcpyable<T>, bool> = true>
+    static status_t writeArray(Parcel* parcel, const T* values, size_t count) {
+        return writeRaw(parcel, values, count, sizeof(T));
+    }
+
+    template <typename T, std::enable_if_t<kIsMemcpyable<T>, bool> = true>
+    static status_t readArray(const Parcel& parcel, std::vector<T>* values) {
+        const void* data;
+        size_t count;
+        if (status_t status = readRaw(parcel, sizeof(T), &data, &count); status != OK) {
+            return status;
+        }
+        values->resize(count);
+        if (count > 0) memcpy(values->data(), data, count * sizeof(T));
+        return OK;
+    }
+
+    // Reads into |values|, which must hold exactly as many elements as the
+    // parcel.
+    template <typename T, std::enable_if_t<kIsMemcpyable<T>, bool> = true>
+    static status_t readArray(const Parcel& parcel, T* values, size_t count) {
+        const void* data;
+        size_t actual;
+        if (status_t status = readRaw(parcel, sizeof(T), &data, &actual); status != OK) {
+            return status;
+        }
+        if (actual != count) return BAD_VALUE;
+        if (count > 0) memcpy(values, data, count * sizeof(T));
+        return OK;
+    }
+
+private:
+    static status_t writeRaw(Parcel* parcel, const void* values, size_t count, size_t size);
+    // Reads the count and bounds checks the elements, which are returned in
+    // place.
+    static status_t readRaw(const Parcel& parcel, size_t size, const void** data, size_t* count);
+};
+
+} // namespace android
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include <utils/Errors.h>
+
+namespace android {
+
+class Parcel;
+
+/**
+ * Bounds checked, read-only view of elements inside a Parcel.
+ */
+template <typename T>
+class ParcelSpan {
+public:
+    ParcelSpan() = default;
+    ParcelSpan(const T* data, size_t size) : mData(data), mSize(size) {}
+
+    const T* data() const { return mData; }
+    size_t size() const { return mSize; }
+    bool empty() const { return mSize == 0; }
+    const T* begin() const { return mData; }
+    const T* end() const { return mData + mSize; }
+    const T& operator[](size_t i) const { return mData[i]; }
+
+    std::vector<T> toVector() const { return std::vector<T>(begin(), end()); }
+
+private:
+    const T* mData = nullptr;
+    size_t mSize = 0;
+};
+
+/**
+ * Zero-copy reads of arrays and strings.
+ *
+ * Counterparts of Parcel::readByteVector(), readInt32Vector(),
+ * readString16() and readString8() that return views into the Parcel's data
+ * instead of copies. For a received transaction that is the buffer the
+ * driver mapped into this process. A view is valid as long as the Parcel
+ * is neither changed nor destroyed, i.e. for the duration of onTransact()
+ * for its data and until the next call for a reply.
+ *
+ *     status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply, uint32_t) {
+ *         ParcelSpan<uint8_t> payload;
+ *         if (status_t err = ParcelViews::readBytes(data, &payload); err != OK) return err;
+ *         parse(payload.data(), payload.size());
+ *
+ * AIDL @utf8InCpp strings travel as UTF-16, so they are read as
+ * std::u16string_view here. Only element types that are at most 4 bytes
+ * wide can be viewed: Parcel data is only 4 byte aligned.
+ */
+class ParcelViews {
+public:
+    // byte[] (writeByteVector()); UNEXPECTED_NULL for a null array.
+    static status_t readBytes(const Parcel& parcel, ParcelSpan<uint8_t>* out);
+    static status_t readBytes(const Parcel& parcel, std::optional<ParcelSpan<uint8_t>>* out);
+
+    // int[] and float[] (writeInt32Vector(), writeFloatVector()).
+    template <typename T,
+              std::enable_if_t<std::is_same_v<T, int32_t> || std::is_same_v<T, float>, bool> = true>
+    static status_t readArray(const Parcel& parcel, ParcelSpan<T>* out) {
+        const void* data;
+        size_t count;
+        if (status_t status = readElements(parcel, sizeof(T), &data, &count); status != OK) {
+            return status;
+        }
+        *out = ParcelSpan<T>(static_cast<const T*>(data), count);
+        return OK;
+    }
+
+    // String16 (writeString16(), AIDL String and @utf8InCpp String). A null
+    // string is read like any other value, then reported as UNEXPECTED_NULL
+    // (or nullopt).
+    static status_t readString16(const Parcel& parcel, std::u16string_view* out);
+    static status_t readString16(const Parcel& parcel, std::optional<std::u16string_view>* out);
+
+    // String8 (writeString8()).
+    static status_t readString8(const Parcel& parcel, std::string_view* out);
+
+private:
+    static status_t readElements(const Parcel& parcel, size_t size, const void** data,
+                                 size_t* count);
+    // Reads the next value if it is a null array or string (length -1),
+    // the way Parcel's own readers consume it.
+    static bool readNull(const Parcel& parcel);
+};
+
+} // namespace android
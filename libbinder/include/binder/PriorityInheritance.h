@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace android {
+
+/**
+ * What the running kernel's binder does with scheduling priorities.
+ *
+ * Mainline kernels carry the caller's nice value over to the thread that
+ * handles a synchronous transaction and honor a node's minimum nice value
+ * (FLAT_BINDER_FLAG_PRIORITY_MASK). Android common kernels also encode a
+ * scheduling policy in the node flags and pass real-time priorities on to
+ * nodes flagged FLAT_BINDER_FLAG_INHERIT_RT (see BBinder::setInheritRt()).
+ * Mainline ignores those bits, but the uapi headers Linux ships do not
+ * define them, so Parcel asks this class for the flags instead.
+ *
+ * The level is detected once: BINDER_PRIORITY_INHERITANCE=none|nice|rt
+ * forces it; otherwise a kernel release naming an Android common kernel
+ * ("-android") selects RealTime and anything else Nice.
+ */
+class PriorityInheritance {
+public:
+    enum class Support {
+        None,
+        Nice,
+        RealTime,
+    };
+
+    static Support support();
+    // Overrides the detection; affects binders flattened afterwards.
+    static void setSupport(Support support);
+    static const char* toString(Support support);
+
+    // Node flags for a minimum scheduling policy and priority, as
+    // understood by the running kernel. Used by Parcel::flattenBinder().
+    static uint32_t schedPolicyMask(int policy, int priority);
+    // FLAT_BINDER_FLAG_INHERIT_RT when the kernel knows it, else 0.
+    static uint32_t inheritRtFlag();
+};
+
+} // namespace android
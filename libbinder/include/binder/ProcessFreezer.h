@@ -0,0 +1,47 @@
+#pragma once
+
+#include <sys/types.h>
+
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+/**
+ * Freezes and thaws binder processes (BINDER_FREEZE).
+ *
+ * A frozen process receives no transactions. Synchronous calls to it fail
+ * right away with BR_FROZEN_REPLY, which reaches the caller as
+ * FAILED_TRANSACTION; lastCallHitFrozen() tells the two apart. Oneway calls
+ * are queued until the process is thawed.
+ *
+ * The process must be in the same binder context (device) as the caller.
+ * Its threads keep running; stopping them (cgroup freezer, SIGSTOP) is up to
+ * the caller. binder_freezer manages idle services this way.
+ */
+class ProcessFreezer {
+public:
+    struct FrozenInfo {
+        // A synchronous call was rejected while frozen.
+        bool syncReceived = false;
+        // Oneway calls were queued while frozen.
+        bool asyncReceived = false;
+    };
+
+    // Waits up to |timeout| for transactions in flight to finish; returns
+    // -EAGAIN if they did not.
+    static status_t freeze(pid_t pid, nsecs_t timeout);
+    static status_t thaw(pid_t pid);
+    // What happened to |pid| since it was frozen.
+    static status_t getFrozenInfo(pid_t pid, FrozenInfo* info);
+
+    // Whether the last transaction of the calling thread failed because its
+    // target is frozen.
+    static bool lastCallHitFrozen();
+
+    // Used by IPCThreadState.
+    static void clearFrozenReply();
+    static void noteFrozenReply();
+};
+
+} // namespace android
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utils/RefBase.h>
+#include <utils/StrongPointer.h>
+
+namespace android {
+
+class IBinder;
+
+/**
+ * Lock-free lookup of the proxies ProcessState already created.
+ *
+ * ProcessState::getStrongProxyForHandle() runs for every binder read from
+ * a Parcel. It used to take the process wide ProcessState lock every time,
+ * so threads reading binders in parallel all queued on it. ProcessState now
+ * asks this table first and only takes its lock to create a proxy, which is
+ * when it also publishes the proxy here.
+ *
+ * The table is indexed by handle and grows in chunks up to kMaxHandles, so
+ * a lookup is two loads. A proxy being destroyed is taken out of the table
+ * in expunge(), which waits for the lookups that might still be using it.
+ * Lookups themselves never wait: each thread announces them in a counter of
+ * its own cache line.
+ *
+ * Handle 0 is left to ProcessState, which returns the context object
+ * instead of a proxy when this process is the context manager.
+ */
+class ProxyTable {
+public:
+    static constexpr size_t kChunkSize = 1024;
+    static constexpr size_t kMaxHandles = 1024 * kChunkSize;
+
+    // Returns true and a strong reference in |out|, which must be empty, if
+    // a live proxy for |handle| is known.
+    static bool lookup(int32_t handle, sp<IBinder>* out);
+
+    // Called with the ProcessState lock held.
+    static void publish(int32_t handle, IBinder* binder, RefBase::weakref_type* refs);
+    // Called by ProcessState::expungeHandle(), with its lock held, before
+    // |binder| is freed.
+    static void expunge(int32_t handle, IBinder* binder);
+};
+
+} // namespace android
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <binder/IBinder.h>
+#include <utils/Errors.h>
+
+namespace android {
+
+class BBinder;
+class Parcel;
+
+/**
+ * Caches replies of idempotent transactions on the client side.
+ *
+ * A service marks the transaction codes whose reply only depends on the
+ * request and on state it controls, and calls invalidate() whenever that
+ * state changes:
+ *
+ *     // service
+ *     ReplyCache::setCacheable(service, {TRANSACTION_getConfig});
+ *     ...
+ *     config = newConfig;
+ *     ReplyCache::invalidate(service);
+ *
+ *     // client
+ *     ReplyCache cache(IInterface::asBinder(proxy));
+ *     Parcel data, reply;
+ *     data.writeInterfaceToken(descriptor);
+ *     cache.transact(TRANSACTION_getConfig, data, &reply);
+ *
+ * Replies are keyed by code and request bytes and tagged with the service's
+ * generation, a counter in shared memory that invalidate() increments. A
+ * hit costs a hash lookup and a load of that counter, no transaction. The
+ * cache asks the service for its codes and the counter with one
+ * QUERY_TRANSACTION on first use; a service without cacheable codes is
+ * passed through. setCacheable() also bumps a second counter next to the
+ * generation, and clients ask for the codes again when it moves.
+ *
+ * Requests and replies carrying binders or file descriptors are never
+ * cached, nor are oneway calls or failed transactions.
+ *
+ * Hits never reach the service, so the cache links to its death and passes
+ * every call through once the obituary arrives. As for any death recipient,
+ * that takes a thread handling binder commands, e.g. the thread pool.
+ * Services can only publish where the kernel seals the counter against
+ * writes by clients (F_SEAL_FUTURE_WRITE, Linux 5.1); elsewhere
+ * setCacheable() fails with INVALID_OPERATION and clients pass through.
+ */
+class ReplyCache {
+public:
+    enum : uint32_t {
+        // Answered by BBinder::transact() through onQuery().
+        QUERY_TRANSACTION = B_PACK_CHARS('_', 'R', 'C', 'Q'),
+    };
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+    };
+
+    // What a service shares with its clients.
+    struct Shared;
+
+    // Service side. Replaces the codes previously marked cacheable.
+    static status_t setCacheable(const sp<BBinder>& service, const std::vector<uint32_t>& codes);
+    // Makes every reply clients cached from |service| stale.
+    static void invalidate(const sp<BBinder>& service);
+    // Called by BBinder::transact() for QUERY_TRANSACTION.
+    static status_t onQuery(BBinder* service, Parcel* reply);
+
+    explicit ReplyCache(const sp<IBinder>& binder, size_t maxEntries = 256);
+    ~ReplyCache();
+
+    ReplyCache(const ReplyCache&) = delete;
+    ReplyCache& operator=(const ReplyCache&) = delete;
+
+    // Same as binder->transact(), answered from the cache when possible.
+    status_t transact(uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags = 0);
+
+    void clear();
+    Stats stats() const;
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<uint8_t> reply;
+    };
+
+    void query();
+    void refreshCodes();
+    int queryCodes(Parcel* reply, std::vector<uint32_t>* codes, uint64_t* codesVersion);
+    bool isCacheable(uint32_t code, const Parcel& data, Parcel* reply, uint32_t flags);
+
+    const sp<IBinder> mBinder;
+    const size_t mMaxEntries;
+
+    std::once_flag mQueried;
+    // The service's counters, mapped read-only; nullptr if it does not
+    // publish any.
+    const Shared* mShared = nullptr;
+    // Version of mCodes, see Shared.
+    std::atomic<uint64_t> mCodesVersion{0};
+    // Set by mDeathRecipient, which may outlive the cache.
+    const std::shared_ptr<std::atomic<bool>> mDead;
+    sp<IBinder::DeathRecipient> mDeathRecipient;
+
+    mutable std::mutex mLock;
+    std::vector<uint32_t> mCodes;
+    // Most recently used first.
+    std::list<Entry> mEntries;
+    std::unordered_map<std::string, std::list<Entry>::iterator> mIndex;
+    Stats mStats;
+};
+
+} // namespace android
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utils/Errors.h>
+
+namespace android {
+
+class Parcel;
+
+/**
+ * Scatter-gather buffers for large payloads.
+ *
+ * writeBuffer() puts a BINDER_TYPE_PTR object into a Parcel that refers to
+ * memory owned by the caller instead of copying that memory into the
+ * Parcel. When the Parcel is sent, the driver copies the buffer straight
+ * into the receiver's binder mapping, next to the transaction data.
+ *
+ *     // client
+ *     Parcel data;
+ *     data.writeInterfaceToken(descriptor);
+ *     ScatterGather::writeBuffer(&data, frame.data(), frame.size());
+ *     binder->transact(CODE_FRAME, data, &reply);
+ *
+ *     // server
+ *     const void* frame;
+ *     size_t size;
+ *     ScatterGather::readBuffer(data, &frame, &size);
+ *
+ * The buffer must stay valid and unchanged until transact() returns. The
+ * pointer returned by readBuffer() is valid as long as the Parcel it was
+ * read from.
+ *
+ * The buffer objects are listed with the Parcel's other objects, so they
+ * survive appendFrom() and a Parcel can be sent more than once. Buffers only
+ * work on the kernel path, and Parcels carrying them are not corked by
+ * OnewayBatch, which would send them after the buffers may be gone.
+ */
+class ScatterGather {
+public:
+    static status_t writeBuffer(Parcel* parcel, const void* data, size_t size);
+    static status_t readBuffer(const Parcel& parcel, const void** outData, size_t* outSize);
+
+    // Whether |parcel| carries buffers.
+    static bool hasBuffers(const Parcel& parcel);
+    // Space the driver needs for the buffers of |parcel|, for the
+    // BC_TRANSACTION_SG and BC_REPLY_SG commands that
+    // IPCThreadState::writeTransactionData() sends for it.
+    static uint64_t buffersSize(const Parcel& parcel);
+};
+
+} // namespace android
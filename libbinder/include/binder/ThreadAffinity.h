@@ -0,0 +1,44 @@
+#pragma once
+
+#include <sched.h>
+
+#include <vector>
+
+#include <utils/Errors.h>
+
+namespace android {
+
+/**
+ * CPU placement of binder pool threads.
+ *
+ * Every thread started by ProcessState::startThreadPool() or
+ * spawnPooledThread() places itself according to this configuration
+ * before it joins the pool:
+ *
+ *  - setCpus() pins all of them to one CPU set.
+ *  - spreadOverNodes() deals them round-robin over NUMA nodes, pins each to
+ *    the CPUs of its node and makes the node the thread's preferred memory
+ *    node, so its stack and heap allocations stay local.
+ *
+ * Threads already in the pool keep their placement. Starting a process with
+ * BINDER_CPUS=<cpu list> (e.g. "0-3,8") or BINDER_CPUS=numa configures the
+ * same.
+ *
+ * Transaction buffers are not covered: the driver allocates their pages
+ * when the sender writes into them.
+ */
+class ThreadAffinity {
+public:
+    static status_t setCpus(const cpu_set_t& cpus);
+    // Parses a list in the format of /sys/devices/system/cpu/online.
+    static status_t setCpuList(const char* list);
+    // Empty |nodes| uses every online node.
+    static status_t spreadOverNodes(const std::vector<int>& nodes = {});
+    // Leaves new pool threads where the scheduler puts them.
+    static void clear();
+
+    // Called by each pool thread as it starts.
+    static void placeCurrentThread();
+};
+
+} // namespace android
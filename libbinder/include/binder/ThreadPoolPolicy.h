@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stddef.h>
+
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+/**
+ * Elastic policy for the threads ProcessState spawns on BR_SPAWN_LOOPER.
+ *
+ * Stock pools only grow: a spawned thread stays until the process exits.
+ * With an idle timeout, a spawned thread that has had nothing to do for
+ * that long leaves through the BC_EXIT_LOOPER path of joinThreadPool(),
+ * as long as more than minThreads spawned threads remain. Main threads,
+ * i.e. the one started by startThreadPool() and any thread that calls
+ * joinThreadPool() itself, are never reaped.
+ *
+ * The driver never forgets a thread it asked for, so every reaped thread
+ * raises the driver's limit by one. At most maxThreads spawned threads are
+ * alive at once.
+ *
+ * Idle threads wait in the driver like any other, so the driver keeps
+ * counting them as waiting and hands work to the one that waited last. A
+ * reaper thread, started by setPolicy() with an idle timeout, interrupts
+ * the wait of a thread idle for longer than that with SIGRTMAX - 1, whose
+ * handler does nothing; the process must leave that signal alone. Under a
+ * light load the same few threads keep taking the work, and the ones behind
+ * them go.
+ */
+class ThreadPoolPolicy {
+public:
+    struct Policy {
+        // Spawned threads that are never reaped.
+        size_t minThreads = 0;
+        // Spawned threads alive at once; replaces
+        // ProcessState::setThreadPoolMaxThreadCount(). Required for reaping.
+        size_t maxThreads = 0;
+        // Idle time after which a spawned thread exits; 0 never reaps.
+        nsecs_t idleTimeout = 0;
+        // Stack size of spawned threads; 0 uses the default.
+        size_t stackSize = 0;
+        // Minimum time between two spawns; 0 spawns as soon as asked.
+        nsecs_t spawnInterval = 0;
+    };
+
+    struct Stats {
+        size_t threads = 0;
+        size_t spawned = 0;
+        size_t reaped = 0;
+    };
+
+    // Call before ProcessState::startThreadPool().
+    static status_t setPolicy(const Policy& policy);
+    static Policy getPolicy();
+    static Stats stats();
+
+    // Used by ProcessState::spawnPooledThread().
+    static size_t stackSize();
+
+    // Lives on the stack of a pool thread for as long as it is in the pool.
+    // Places the thread (see ThreadAffinity) and, for a spawned thread,
+    // waits out the spawn interval first.
+    class Member {
+    public:
+        explicit Member(bool isMain);
+        ~Member();
+
+        Member(const Member&) = delete;
+        Member& operator=(const Member&) = delete;
+
+    private:
+        const bool mIsMain;
+    };
+
+    // Used by IPCThreadState::getAndExecuteCommand() when the thread has
+    // nothing to execute.
+    //
+    // Whether the calling thread may be reaped at all.
+    static bool mayReap();
+    // Around the talk that waits for a command. Unless beginIdle() returns
+    // false, endIdle() must follow with the result of the talk; it returns
+    // true when the thread should leave the pool.
+    static bool beginIdle();
+    static bool endIdle(status_t result);
+
+    // Used by IPCThreadState::talkWithDriver(): whether an interrupted wait
+    // must return instead of being restarted, so that the thread can go.
+    static bool reapRequested();
+};
+
+} // namespace android
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <android-base/unique_fd.h>
+#include <binder/IBinder.h>
+#include <utils/Errors.h>
+#include <utils/StrongPointer.h>
+
+namespace android {
+
+class Parcel;
+
+/**
+ * Capture mode for local binders.
+ *
+ * While a binder is being captured, every transaction IPCThreadState
+ * executes on it is appended to a file as a
+ * binder::debug::RecordedTransaction (request, reply, status and
+ * timestamp). binder_replay reads such files back and fires them at a live
+ * service.
+ *
+ * Starting a process with BINDER_RECORD=<path> captures every local binder
+ * of the process into <path>; a "%p" in the path is replaced by the pid.
+ *
+ * Upstream BBinder::startRecordingTransactions() writes the same format,
+ * but only in builds with recording enabled, only when asked over binder by
+ * a shell or root caller, and one binder at a time. This works from inside
+ * the process, in any build, and for all binders of a process at once.
+ *
+ * Only the Parcel data is captured. Binder objects and file descriptors in
+ * a transaction are not, so those transactions cannot be replayed
+ * faithfully.
+ */
+class TransactionRecorder {
+public:
+    // Starts streaming transactions executed on |binder| to |fd|. |binder|
+    // must be local. Replaces a capture already running on |binder|.
+    static status_t start(const sp<IBinder>& binder, base::unique_fd fd);
+    static status_t stop(const sp<IBinder>& binder);
+
+    // Called by IPCThreadState after a BR_TRANSACTION was executed on the
+    // BBinder |target| (nullptr for the context manager).
+    static void record(const void* target, uint32_t code, uint32_t flags, const Parcel& data,
+                       const Parcel& reply, status_t err);
+};
+
+} // namespace android
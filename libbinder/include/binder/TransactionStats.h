@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include <utils/Errors.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+class Parcel;
+
+/**
+ * Per interface, per transaction code latency histograms.
+ *
+ * IPCThreadState records the client round trip of every two-way
+ * IPCThreadState::transact() and the handler time of every BR_TRANSACTION
+ * it executes. Samples go into histograms owned by the calling thread, so
+ * recording never takes a lock; snapshot() sums them over all threads.
+ *
+ * Recording is off by default. It is turned on with setEnabled(true) or by
+ * starting the process with BINDER_TRANSACTION_STATS=1. Services that want
+ * the aggregate in their dumpsys output print it from their own dump():
+ *
+ *     status_t MyService::dump(int fd, const Vector<String16>& args) {
+ *         ...
+ *         return TransactionStats::dump(fd);
+ *     }
+ */
+class TransactionStats {
+public:
+    /**
+     * Log-linear histogram of nanosecond samples with 8 sub-buckets per
+     * power of two, i.e. values are kept with a relative error below 12.5%.
+     * Samples above kMaxValue are clamped.
+     */
+    struct Histogram {
+        static constexpr size_t kSubBucketBits = 3;
+        static constexpr size_t kSubBuckets = 1 << kSubBucketBits;
+        static constexpr size_t kMaxExponent = 40;
+        static constexpr nsecs_t kMaxValue = (1ll << kMaxExponent) - 1;
+        static constexpr size_t kBucketCount = (kMaxExponent - kSubBucketBits + 1) * kSubBuckets;
+
+        uint64_t counts[kBucketCount] = {};
+        uint64_t count = 0;
+        nsecs_t sum = 0;
+        nsecs_t max = 0;
+
+        static size_t bucketOf(nsecs_t value);
+        static nsecs_t bucketUpperBound(size_t bucket);
+
+        // Upper bound of the bucket holding the |p| quantile, 0 if empty.
+        nsecs_t percentile(double p) const;
+        void merge(const Histogram& other);
+    };
+
+    struct Entry {
+        std::string descriptor;
+        uint32_t code = 0;
+        Histogram client;
+        Histogram server;
+    };
+
+    static void setEnabled(bool enabled);
+    static bool isEnabled();
+
+    // Returns the start timestamp for a later record call, or 0 when
+    // recording is off.
+    static nsecs_t start();
+
+    // |data| is the transaction payload, its interface token (if any) picks
+    // the descriptor. Does nothing when |start| is 0.
+    static void recordClient(const Parcel& data, uint32_t code, nsecs_t start);
+    static void recordServer(const Parcel& data, uint32_t code, nsecs_t start);
+
+    // Aggregate over all threads, including threads that already exited.
+    static std::vector<Entry> snapshot();
+    static void reset();
+
+    // Writes a human readable table of snapshot() to |fd|.
+    static status_t dump(int fd);
+};
+
+} // namespace android
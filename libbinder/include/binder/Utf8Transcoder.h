@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace android {
+
+/**
+ * UTF-8 <-> UTF-16 conversion used by Parcel for @utf8InCpp strings.
+ *
+ * Drop-in replacements for utf8_to_utf16_length(), utf8_to_utf16(),
+ * utf16_to_utf8_length() and utf16_to_utf8() of libutils, with the same
+ * results for valid and invalid input. Runs of ASCII are measured and
+ * converted 16 or 32 characters at a time (SSE2/AVX2 on x86-64, NEON on
+ * arm64); everything else goes one code point at a time as before.
+ */
+class Utf8Transcoder {
+public:
+    // Number of UTF-16 units |src| converts to, or -1 if it is malformed.
+    static ssize_t utf8ToUtf16Length(const uint8_t* src, size_t srcLen);
+    // Converts at most |dstLen| - 1 units and terminates |dst|; returns the
+    // position of the terminator. |dstLen| must not be 0.
+    static char16_t* utf8ToUtf16(const uint8_t* src, size_t srcLen, char16_t* dst,
+                                 size_t dstLen);
+
+    // Number of UTF-8 bytes |src| converts to, without the terminator, or -1
+    // if |src| is null or empty. Unpaired surrogates are dropped.
+    static ssize_t utf16ToUtf8Length(const char16_t* src, size_t srcLen);
+    // |dstLen| must hold utf16ToUtf8Length() + 1 bytes.
+    static void utf16ToUtf8(const char16_t* src, size_t srcLen, char* dst, size_t dstLen);
+};
+
+} // namespace android
@@ -0,0 +1,364 @@
+// This is a replacement of libcutils/trace-host.cpp for Linux desktop.
+//
+// trace-host.cpp turns every ATRACE_* macro into a no-op. This backend keeps
+// the ATRACE API but can be switched on at runtime through the environment:
+//
+//   BINDER_TRACE=ftrace        write systrace style markers to trace_marker
+//   BINDER_TRACE=json:<path>   write a Chrome JSON trace (chrome://tracing,
+//                              ui.perfetto.dev), one file per process
+//   BINDER_TRACE_TAGS=<mask>   ATRACE_TAG_* mask to enable (default: all)
+//
+// A "%p" in the json path is replaced by the pid. When BINDER_TRACE is unset
+// the enabled tags stay 0 and ATRACE_* costs one load and a branch.
+
+#define LOG_TAG "trace-linux"
+
+#include <cutils/trace.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <log/log.h>
+
+atomic_bool             atrace_is_ready      = false;
+int                     atrace_marker_fd     = -1;
+uint64_t                atrace_enabled_tags  = 0;
+
+namespace {
+
+enum class Backend { NONE, FTRACE, JSON };
+
+// Per thread JSON events are buffered and written out in chunks of this size.
+constexpr size_t kJsonFlushSize = 16 * 1024;
+// Longest ftrace marker; longer names are truncated like the Android backend.
+constexpr size_t kMarkerSize = 1024;
+
+Backend gBackend = Backend::NONE;
+uint64_t gConfiguredTags = 0;
+int gJsonFd = -1;
+std::once_flag gSetupOnce;
+std::mutex gJsonFileLock;
+
+struct ThreadBuffer;
+std::mutex gBuffersLock;
+std::vector<ThreadBuffer*>* gBuffers = nullptr;
+
+pid_t gettid_cached() {
+    static thread_local pid_t tid = static_cast<pid_t>(syscall(SYS_gettid));
+    return tid;
+}
+
+void writeJsonFile(const std::string& data) {
+    if (data.empty() || gJsonFd < 0) return;
+    std::lock_guard<std::mutex> guard(gJsonFileLock);
+    const char* p = data.data();
+    size_t left = data.size();
+    while (left > 0) {
+        ssize_t n = TEMP_FAILURE_RETRY(write(gJsonFd, p, left));
+        if (n <= 0) break;
+        p += n;
+        left -= n;
+    }
+}
+
+struct ThreadBuffer {
+    std::mutex lock;
+    std::string data;
+
+    ThreadBuffer() {
+        data.reserve(kJsonFlushSize + kMarkerSize);
+        std::lock_guard<std::mutex> guard(gBuffersLock);
+        if (gBuffers == nullptr) gBuffers = new std::vector<ThreadBuffer*>();
+        gBuffers->push_back(this);
+    }
+
+    ~ThreadBuffer() {
+        {
+            std::lock_guard<std::mutex> guard(gBuffersLock);
+            gBuffers->erase(std::remove(gBuffers->begin(), gBuffers->end(), this),
+                            gBuffers->end());
+        }
+        flush();
+    }
+
+    void flush() {
+        std::lock_guard<std::mutex> guard(lock);
+        writeJsonFile(data);
+        data.clear();
+    }
+};
+
+ThreadBuffer& threadBuffer() {
+    static thread_local ThreadBuffer buffer;
+    return buffer;
+}
+
+void flushAllBuffers() {
+    std::lock_guard<std::mutex> guard(gBuffersLock);
+    if (gBuffers == nullptr) return;
+    for (ThreadBuffer* buffer : *gBuffers) {
+        buffer->flush();
+    }
+}
+
+uint64_t readTagsFromEnv() {
+    const char* tags = getenv("BINDER_TRACE_TAGS");
+    if (tags == nullptr || *tags == '\0') return ATRACE_TAG_VALID_MASK;
+    return strtoull(tags, nullptr, 0) & ATRACE_TAG_VALID_MASK;
+}
+
+int openTraceMarker() {
+    static const char* const kPaths[] = {
+        "/sys/kernel/tracing/trace_marker",
+        "/sys/kernel/debug/tracing/trace_marker",
+    };
+    for (const char* path : kPaths) {
+        int fd = open(path, O_WRONLY | O_CLOEXEC);
+        if (fd >= 0) return fd;
+    }
+    ALOGE("Error opening trace_marker: %s (%d)", strerror(errno), errno);
+    return -1;
+}
+
+int openJsonFile(const char* pattern) {
+    std::string path;
+    for (const char* p = pattern; *p != '\0'; p++) {
+        if (p[0] == '%' && p[1] == 'p') {
+            path += std::to_string(getpid());
+            p++;
+        } else {
+            path += *p;
+        }
+    }
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        ALOGE("Error opening trace file %s: %s (%d)", path.c_str(), strerror(errno), errno);
+        return -1;
+    }
+    // The JSON array format does not require the closing bracket, so events
+    // can be appended until the process dies.
+    TEMP_FAILURE_RETRY(write(fd, "[\n", 2));
+    return fd;
+}
+
+void setupOnce() {
+    const char* backend = getenv("BINDER_TRACE");
+    if (backend == nullptr || *backend == '\0') {
+        // Nothing to do.
+    } else if (!strcmp(backend, "ftrace")) {
+        atrace_marker_fd = openTraceMarker();
+        if (atrace_marker_fd >= 0) gBackend = Backend::FTRACE;
+    } else if (!strncmp(backend, "json:", 5)) {
+        gJsonFd = openJsonFile(backend + 5);
+        if (gJsonFd >= 0) {
+            gBackend = Backend::JSON;
+            atexit(flushAllBuffers);
+        }
+    } else {
+        ALOGE("Unknown BINDER_TRACE backend '%s'", backend);
+    }
+
+    if (gBackend != Backend::NONE) {
+        gConfiguredTags = readTagsFromEnv();
+        atrace_enabled_tags = gConfiguredTags;
+    }
+    atomic_store_explicit(&atrace_is_ready, true, memory_order_release);
+}
+
+void writeMarker(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+
+void writeMarker(const char* fmt, ...) {
+    char buf[kMarkerSize];
+    va_list ap;
+    va_start(ap, fmt);
+    int len = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    if (len < 0) return;
+    len = std::min(len, static_cast<int>(sizeof(buf)) - 1);
+    TEMP_FAILURE_RETRY(write(atrace_marker_fd, buf, len));
+}
+
+double nowUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+void appendEscaped(std::string& out, const char* s) {
+    for (; *s != '\0'; s++) {
+        unsigned char c = static_cast<unsigned char>(*s);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char esc[8];
+            snprintf(esc, sizeof(esc), "\\u%04x", c);
+            out += esc;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+}
+
+// Appends one Chrome trace event. |extra| is inserted verbatim and must
+// either be empty or start with a comma.
+void writeJsonEvent(char phase, const char* name, const char* extra) {
+    ThreadBuffer& buffer = threadBuffer();
+    char head[128];
+    snprintf(head, sizeof(head), "{\"ph\":\"%c\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d,\"name\":\"",
+             phase, nowUs(), getpid(), gettid_cached());
+
+    std::lock_guard<std::mutex> guard(buffer.lock);
+    buffer.data += head;
+    appendEscaped(buffer.data, name);
+    buffer.data += '"';
+    buffer.data += extra;
+    buffer.data += "},\n";
+    if (buffer.data.size() >= kJsonFlushSize) {
+        writeJsonFile(buffer.data);
+        buffer.data.clear();
+    }
+}
+
+std::string jsonCookie(int32_t cookie) {
+    return ",\"cat\":\"async\",\"id\":" + std::to_string(cookie);
+}
+
+std::string jsonArgName(const char* name) {
+    std::string extra = ",\"args\":{\"name\":\"";
+    appendEscaped(extra, name);
+    extra += "\"}";
+    return extra;
+}
+
+void writeCounter(const char* name, int64_t value) {
+    if (gBackend == Backend::FTRACE) {
+        writeMarker("C|%d|%s|%" PRId64, getpid(), name, value);
+    } else if (gBackend == Backend::JSON) {
+        std::string extra = ",\"args\":{\"value\":" + std::to_string(value) + "}";
+        writeJsonEvent('C', name, extra.c_str());
+    }
+}
+
+} // namespace
+
+// trace.h declares the *_body functions at block scope inside its C linkage
+// section, spell the linkage out so every compiler agrees.
+extern "C" {
+
+void atrace_set_debuggable(bool /*debuggable*/) {}
+
+void atrace_set_tracing_enabled(bool enabled) {
+    atrace_init();
+    atrace_enabled_tags = enabled ? gConfiguredTags : 0;
+}
+
+void atrace_update_tags() {
+    atrace_init();
+    if (gBackend == Backend::NONE) return;
+    gConfiguredTags = readTagsFromEnv();
+    atrace_enabled_tags = gConfiguredTags;
+}
+
+void atrace_setup() {
+    std::call_once(gSetupOnce, setupOnce);
+}
+
+void atrace_init() {
+    if (CC_UNLIKELY(!atomic_load_explicit(&atrace_is_ready, memory_order_acquire))) {
+        atrace_setup();
+    }
+}
+
+uint64_t atrace_get_enabled_tags() {
+    atrace_init();
+    return atrace_enabled_tags;
+}
+
+void atrace_begin_body(const char* name) {
+    if (gBackend == Backend::FTRACE) {
+        writeMarker("B|%d|%s", getpid(), name);
+    } else if (gBackend == Backend::JSON) {
+        writeJsonEvent('B', name, "");
+    }
+}
+
+void atrace_end_body() {
+    if (gBackend == Backend::FTRACE) {
+        writeMarker("E|%d", getpid());
+    } else if (gBackend == Backend::JSON) {
+        writeJsonEvent('E', "", "");
+    }
+}
+
+void atrace_async_begin_body(const char* name, int32_t cookie) {
+    if (gBackend == Backend::FTRACE) {
+        writeMarker("S|%d|%s|%" PRId32, getpid(), name, cookie);
+    } else if (gBackend == Backend::JSON) {
+        writeJsonEvent('b', name, jsonCookie(cookie).c_str());
+    }
+}
+
+void atrace_async_end_body(const char* name, int32_t cookie) {
+    if (gBackend == Backend::FTRACE) {
+        writeMarker("F|%d|%s|%" PRId32, getpid(), name, cookie);
+    } else if (gBackend == Backend::JSON) {
+        writeJsonEvent('e', name, jsonCookie(cookie).c_str());
+    }
+}
+
+void atrace_async_for_track_begin_body(const char* trackName, const char* name, int32_t cookie) {
+    if (gBackend == Backend::FTRACE) {
+        writeMarker("G|%d|%s|%s|%" PRId32, getpid(), trackName, name, cookie);
+    } else if (gBackend == Backend::JSON) {
+        // The end event only knows the track, so the track names the slice.
+        writeJsonEvent('b', trackName, (jsonCookie(cookie) + jsonArgName(name)).c_str());
+    }
+}
+
+void atrace_async_for_track_end_body(const char* trackName, int32_t cookie) {
+    if (gBackend == Backend::FTRACE) {
+        writeMarker("H|%d|%s|%" PRId32, getpid(), trackName, cookie);
+    } else if (gBackend == Backend::JSON) {
+        writeJsonEvent('e', trackName, jsonCookie(cookie).c_str());
+    }
+}
+
+void atrace_instant_body(const char* name) {
+    if (gBackend == Backend::FTRACE) {
+        writeMarker("I|%d|%s", getpid(), name);
+    } else if (gBackend == Backend::JSON) {
+        writeJsonEvent('i', name, ",\"s\":\"t\"");
+    }
+}
+
+void atrace_instant_for_track_body(const char* trackName, const char* name) {
+    if (gBackend == Backend::FTRACE) {
+        writeMarker("N|%d|%s|%s", getpid(), trackName, name);
+    } else if (gBackend == Backend::JSON) {
+        writeJsonEvent('i', trackName, (",\"s\":\"p\"" + jsonArgName(name)).c_str());
+    }
+}
+
+void atrace_int_body(const char* name, int32_t value) {
+    writeCounter(name, value);
+}
+
+void atrace_int64_body(const char* name, int64_t value) {
+    writeCounter(name, value);
+}
+
+} // extern "C"
@@ -0,0 +1,467 @@
+#define LOG_TAG "BinderBench"
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <binder/IPCThreadState.h>
+#include <binder/IServiceManager.h>
+#include <binder/ProcessState.h>
+
+#include <BpBinderBench.h>
+#include <BnBinderBench.h>
+
+#include <utils/Log.h>
+#include <utils/Timers.h>
+
+using namespace android;
+
+// binder_bench drives IBinderBench across a matrix of payload sizes, client
+// thread counts and server thread pool sizes. For every pool size a fresh
+// server process is spawned (by re-executing this binary) so that results of
+// one configuration do not leak into the next one.
+//
+// Two calls are measured: the two-way echoBytes() and the oneway sink(). A
+// sink() call returns once the driver has queued it, so its latency is the
+// cost of sending. Oneway calls to one service are delivered one at a time;
+// a call that finds the server's async buffer space full is retried after a
+// short sleep, and the wait counts towards its latency.
+
+class BnBench : public BnBinderBench {
+public:
+    ::android::binder::Status echo(int32_t in, int32_t* out) override {
+        *out = in;
+        return ::android::binder::Status::ok();
+    }
+
+    ::android::binder::Status echoBytes(const std::vector<uint8_t>& in,
+                                        std::vector<uint8_t>* out) override {
+        *out = in;
+        return ::android::binder::Status::ok();
+    }
+
+    ::android::binder::Status sink(const std::vector<uint8_t>& /*in*/) override {
+        return ::android::binder::Status::ok();
+    }
+};
+
+enum class Call {
+    Echo,
+    Sink,
+};
+
+struct Options {
+    std::string driver;
+    std::string name;
+    std::string json;
+    std::vector<Call> calls = {Call::Echo, Call::Sink};
+    std::vector<size_t> sizes = {0, 64, 1024, 16 * 1024, 128 * 1024};
+    std::vector<size_t> threads = {1, 2, 4, 8};
+    std::vector<size_t> pools = {1, 4, 15};
+    size_t iterations = 10000;
+    size_t warmup = 1000;
+};
+
+struct Result {
+    Call call;
+    size_t payload;
+    size_t threads;
+    size_t pool;
+    uint64_t calls;
+    uint64_t errors;
+    double seconds;
+    nsecs_t min;
+    nsecs_t p50;
+    nsecs_t p99;
+    nsecs_t p999;
+    nsecs_t max;
+    double mean;
+};
+
+static void usage(const char* prog) {
+    printf("Usage: %s [client|server] [options]\n"
+           "\n"
+           "  --driver PATH       binder device (default: /dev/binder)\n"
+           "  --calls A,B         calls to measure: echo (two-way), sink (oneway)\n"
+           "                      (default: echo,sink)\n"
+           "  --sizes A,B,...     payload sizes in bytes (default: 0,64,1024,16384,131072)\n"
+           "  --threads A,B,...   client thread counts (default: 1,2,4,8)\n"
+           "  --pools A,B,...     server thread pool sizes (default: 1,4,15)\n"
+           "  --iterations N      measured calls per client thread (default: 10000)\n"
+           "  --warmup N          unmeasured calls per client thread (default: 1000)\n"
+           "  --name NAME         use an already running server instead of spawning one\n"
+           "  --json PATH         also write results as JSON ('-' for stdout)\n"
+           "\n"
+           "Server mode only uses --driver, --name and the first entry of --pools.\n"
+           "\nExample)\n$ %s --sizes 0,4096 --threads 1,4 --json result.json\n",
+           prog, prog);
+}
+
+static bool parseList(const char* arg, std::vector<size_t>* out) {
+    out->clear();
+    std::string list(arg);
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        std::string item = list.substr(pos, end - pos);
+        char* last = nullptr;
+        unsigned long long value = strtoull(item.c_str(), &last, 0);
+        if (item.empty() || *last != '\0') return false;
+        out->push_back(static_cast<size_t>(value));
+        pos = end + 1;
+    }
+    return !out->empty();
+}
+
+static bool parseCalls(const char* arg, std::vector<Call>* out) {
+    out->clear();
+    std::string list(arg);
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        std::string item = list.substr(pos, end - pos);
+        if (item == "echo") {
+            out->push_back(Call::Echo);
+        } else if (item == "sink") {
+            out->push_back(Call::Sink);
+        } else {
+            return false;
+        }
+        pos = end + 1;
+    }
+    return !out->empty();
+}
+
+static const char* callName(Call call) {
+    return call == Call::Echo ? "echo" : "sink";
+}
+
+static void initProcessState(const Options& opts) {
+    if (!opts.driver.empty()) {
+        ProcessState::initWithDriver(opts.driver.c_str());
+    }
+}
+
+static int runServer(const Options& opts) {
+    size_t pool = opts.pools.empty() ? 1 : std::max<size_t>(opts.pools[0], 1);
+
+    initProcessState(opts);
+    // The thread startThreadPool() spawns and the main thread, which joins
+    // the pool itself, are not counted by the driver; it may spawn the rest.
+    ProcessState::self()->setThreadPoolMaxThreadCount(pool > 2 ? pool - 2 : 0);
+
+    sp<IServiceManager> sm = defaultServiceManager();
+    sp<BnBench> service = sp<BnBench>::make();
+    if (sm->addService(String16(opts.name.c_str()), service) != NO_ERROR) {
+        fprintf(stderr, "Failed addService(%s)\n", opts.name.c_str());
+        return 1;
+    }
+
+    // Without a started pool, the driver's requests for more threads are
+    // ignored.
+    if (pool > 1) ProcessState::self()->startThreadPool();
+    IPCThreadState::self()->joinThreadPool();
+    return 0;
+}
+
+static pid_t spawnServer(const Options& opts, size_t pool, const std::string& name) {
+    std::string poolArg = std::to_string(pool);
+    std::vector<const char*> args = {"binder_bench", "server", "--pools", poolArg.c_str(),
+                                     "--name", name.c_str()};
+    if (!opts.driver.empty()) {
+        args.push_back("--driver");
+        args.push_back(opts.driver.c_str());
+    }
+    args.push_back(nullptr);
+
+    // The child must not touch binder between fork() and exec(), it gets a
+    // brand new ProcessState from the exec'd image.
+    pid_t pid = fork();
+    if (pid == 0) {
+        execv("/proc/self/exe", const_cast<char* const*>(args.data()));
+        _exit(127);
+    }
+    return pid;
+}
+
+// Like waitForService(), but gives up when the spawned server exits instead
+// of blocking forever. |pid| is -1 for an external server and is cleared
+// once the server has been reaped.
+static sp<IBinderBench> waitForServer(pid_t* pid, const std::string& name) {
+    if (*pid < 0) return waitForService<IBinderBench>(String16(name.c_str()));
+    while (true) {
+        sp<IBinder> binder = defaultServiceManager()->checkService(String16(name.c_str()));
+        if (binder != nullptr) return interface_cast<IBinderBench>(binder);
+        int status;
+        if (waitpid(*pid, &status, WNOHANG) == *pid) {
+            fprintf(stderr, "Server exited with status %d\n",
+                    WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+            *pid = -1;
+            return nullptr;
+        }
+        usleep(10000);
+    }
+}
+
+static void stopServer(pid_t pid) {
+    if (pid <= 0) return;
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+}
+
+static nsecs_t percentile(const std::vector<nsecs_t>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(p * sorted.size());
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+// One call of the measured kind; false if it failed.
+static bool callOnce(const sp<IBinderBench>& bench, Call call, const std::vector<uint8_t>& request,
+                     std::vector<uint8_t>* reply) {
+    if (call == Call::Echo) {
+        return bench->echoBytes(request, reply).isOk() && reply->size() == request.size();
+    }
+    while (true) {
+        ::android::binder::Status status = bench->sink(request);
+        if (status.isOk()) return true;
+        // The server's async space is full; let it drain.
+        if (status.transactionError() != FAILED_TRANSACTION) return false;
+        usleep(50);
+    }
+}
+
+static Result runCase(const sp<IBinderBench>& bench, const Options& opts, Call call,
+                      size_t payload, size_t threads, size_t pool) {
+    std::vector<std::vector<nsecs_t>> latencies(threads);
+    std::vector<uint64_t> errors(threads, 0);
+    std::mutex lock;
+    std::condition_variable cond;
+    size_t ready = 0;
+    bool go = false;
+    nsecs_t start = 0;
+
+    auto worker = [&](size_t index) {
+        std::vector<uint8_t> request(payload, 0xa5);
+        std::vector<uint8_t> reply;
+        std::vector<nsecs_t>& samples = latencies[index];
+        samples.reserve(opts.iterations);
+
+        for (size_t i = 0; i < opts.warmup; i++) {
+            callOnce(bench, call, request, &reply);
+        }
+
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            ready++;
+            cond.notify_all();
+            cond.wait(guard, [&] { return go; });
+        }
+
+        for (size_t i = 0; i < opts.iterations; i++) {
+            nsecs_t begin = systemTime(SYSTEM_TIME_MONOTONIC);
+            bool ok = callOnce(bench, call, request, &reply);
+            nsecs_t end = systemTime(SYSTEM_TIME_MONOTONIC);
+            if (!ok) {
+                errors[index]++;
+                continue;
+            }
+            samples.push_back(end - begin);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back(worker, i);
+    }
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        cond.wait(guard, [&] { return ready == threads; });
+        start = systemTime(SYSTEM_TIME_MONOTONIC);
+        go = true;
+        cond.notify_all();
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+    nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+
+    std::vector<nsecs_t> all;
+    Result result = {};
+    for (size_t i = 0; i < threads; i++) {
+        all.insert(all.end(), latencies[i].begin(), latencies[i].end());
+        result.errors += errors[i];
+    }
+    std::sort(all.begin(), all.end());
+
+    double sum = 0;
+    for (nsecs_t v : all) sum += v;
+
+    result.call = call;
+    result.payload = payload;
+    result.threads = threads;
+    result.pool = pool;
+    result.calls = all.size();
+    result.seconds = elapsed / 1e9;
+    result.min = all.empty() ? 0 : all.front();
+    result.p50 = percentile(all, 0.50);
+    result.p99 = percentile(all, 0.99);
+    result.p999 = percentile(all, 0.999);
+    result.max = all.empty() ? 0 : all.back();
+    result.mean = all.empty() ? 0 : sum / all.size();
+    return result;
+}
+
+static void printText(const std::vector<Result>& results) {
+    printf("%5s %8s %7s %5s %10s %12s %10s %10s %10s %10s %6s\n", "call", "payload", "threads",
+           "pool", "calls", "calls/sec", "p50(us)", "p99(us)", "p999(us)", "max(us)", "errors");
+    for (const Result& r : results) {
+        printf("%5s %8zu %7zu %5zu %10" PRIu64 " %12.0f %10.2f %10.2f %10.2f %10.2f %6" PRIu64
+               "\n",
+               callName(r.call), r.payload, r.threads, r.pool, r.calls, r.seconds > 0 ? r.calls / r.seconds : 0,
+               r.p50 / 1e3, r.p99 / 1e3, r.p999 / 1e3, r.max / 1e3, r.errors);
+    }
+}
+
+static bool writeJson(const std::string& path, const Options& opts,
+                      const std::vector<Result>& results) {
+    FILE* out = path == "-" ? stdout : fopen(path.c_str(), "w");
+    if (out == nullptr) {
+        fprintf(stderr, "%s - Failed to open %s\n", strerror(errno), path.c_str());
+        return false;
+    }
+
+    fprintf(out, "{\n  \"benchmark\": \"binder_bench\",\n");
+    fprintf(out, "  \"iterations\": %zu,\n  \"warmup\": %zu,\n", opts.iterations, opts.warmup);
+    fprintf(out, "  \"results\": [\n");
+    for (size_t i = 0; i < results.size(); i++) {
+        const Result& r = results[i];
+        fprintf(out,
+                "    {\"call\": \"%s\", \"payload\": %zu, \"threads\": %zu, \"pool\": %zu, \"calls\": %" PRIu64
+                ", \"errors\": %" PRIu64 ", \"seconds\": %.6f, \"calls_per_sec\": %.1f, "
+                "\"latency_ns\": {\"min\": %" PRId64 ", \"p50\": %" PRId64 ", \"p99\": %" PRId64
+                ", \"p999\": %" PRId64 ", \"max\": %" PRId64 ", \"mean\": %.1f}}%s\n",
+                callName(r.call), r.payload, r.threads, r.pool, r.calls, r.errors, r.seconds,
+                r.seconds > 0 ? r.calls / r.seconds : 0, r.min, r.p50, r.p99, r.p999, r.max,
+                r.mean, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+
+    if (out != stdout) fclose(out);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option longOptions[] = {
+            {"driver", required_argument, nullptr, 'd'},
+            {"calls", required_argument, nullptr, 'c'},
+            {"sizes", required_argument, nullptr, 's'},
+            {"threads", required_argument, nullptr, 't'},
+            {"pools", required_argument, nullptr, 'p'},
+            {"iterations", required_argument, nullptr, 'n'},
+            {"warmup", required_argument, nullptr, 'w'},
+            {"name", required_argument, nullptr, 'N'},
+            {"json", required_argument, nullptr, 'j'},
+            {"help", no_argument, nullptr, 'h'},
+            {nullptr, 0, nullptr, 0},
+    };
+
+    Options opts;
+    bool server = false;
+    if (argc > 1 && argv[1][0] != '-') {
+        if (!strcmp(argv[1], "server")) {
+            server = true;
+        } else if (strcmp(argv[1], "client")) {
+            usage(argv[0]);
+            return 1;
+        }
+        optind = 2;
+    }
+
+    int c;
+    while ((c = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+        bool ok = true;
+        switch (c) {
+            case 'd': opts.driver = optarg; break;
+            case 'c': ok = parseCalls(optarg, &opts.calls); break;
+            case 's': ok = parseList(optarg, &opts.sizes); break;
+            case 't': ok = parseList(optarg, &opts.threads); break;
+            case 'p': ok = parseList(optarg, &opts.pools); break;
+            case 'n': opts.iterations = strtoull(optarg, nullptr, 0); break;
+            case 'w': opts.warmup = strtoull(optarg, nullptr, 0); break;
+            case 'N': opts.name = optarg; break;
+            case 'j': opts.json = optarg; break;
+            default: ok = false; break;
+        }
+        if (!ok) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (server) {
+        if (opts.name.empty()) {
+            usage(argv[0]);
+            return 1;
+        }
+        return runServer(opts);
+    }
+
+    initProcessState(opts);
+    ProcessState::self()->setThreadPoolMaxThreadCount(0);
+
+    // An explicit --name means the server is managed by the caller and its
+    // pool size is unknown, it is reported as 0.
+    bool external = !opts.name.empty();
+    std::vector<size_t> pools = external ? std::vector<size_t>{0} : opts.pools;
+
+    std::vector<Result> results;
+    for (size_t pool : pools) {
+        std::string name = opts.name;
+        pid_t pid = -1;
+        if (!external) {
+            name = "binder.bench." + std::to_string(getpid()) + "." + std::to_string(pool);
+            pid = spawnServer(opts, std::max<size_t>(pool, 1), name);
+            if (pid < 0) {
+                fprintf(stderr, "%s - Failed to spawn server\n", strerror(errno));
+                return 1;
+            }
+        }
+
+        sp<IBinderBench> bench = waitForServer(&pid, name);
+        if (bench == nullptr) {
+            fprintf(stderr, "Failed to get service %s\n", name.c_str());
+            stopServer(pid);
+            continue;
+        }
+        for (Call call : opts.calls) {
+            for (size_t payload : opts.sizes) {
+                for (size_t threads : opts.threads) {
+                    results.push_back(runCase(bench, opts, call, payload,
+                                              std::max<size_t>(threads, 1), pool));
+                }
+            }
+        }
+        stopServer(pid);
+    }
+
+    printText(results);
+    if (!opts.json.empty() && !writeJson(opts.json, opts, results)) {
+        return 1;
+    }
+    return results.empty() ? 1 : 0;
+}
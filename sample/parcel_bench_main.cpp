@@ -0,0 +1,442 @@
+#define LOG_TAG "ParcelBench"
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <binder/Binder.h>
+#include <binder/Parcel.h>
+#include <binder/ParcelSizing.h>
+#include <binder/Parcelable.h>
+
+#include <utils/String16.h>
+#include <utils/Timers.h>
+
+using namespace android;
+
+// parcel_bench times the Parcel marshalling paths in isolation. Nothing here
+// talks to the binder driver: objects written by the cases are only read back
+// from the same process.
+//
+// Allocations are counted by interposing the glibc malloc family, so both
+// operator new (libc++ forwards to malloc) and Parcel's own realloc() based
+// growth show up in the allocs/op column.
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+static bool gCounting = false;
+static uint64_t gAllocs = 0;
+static uint64_t gAllocBytes = 0;
+
+extern "C" void* malloc(size_t size) {
+    if (gCounting) {
+        gAllocs++;
+        gAllocBytes += size;
+    }
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size) {
+    if (gCounting) {
+        gAllocs++;
+        gAllocBytes += n * size;
+    }
+    return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    if (gCounting) {
+        gAllocs++;
+        gAllocBytes += size;
+    }
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+template <typename T>
+static inline void doNotOptimize(T const& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Stand-in for a generated structured parcelable with nested parcelables.
+class Nested : public Parcelable {
+public:
+    Nested(size_t depth, size_t width) : values(width, 7), name(u"nested parcelable") {
+        if (depth > 0) children.assign(width / 16, Nested(depth - 1, width));
+    }
+
+    status_t writeToParcel(Parcel* parcel) const override {
+        // Size prefix like generated code.
+        const size_t start = parcel->dataPosition();
+        parcel->writeInt32(0);
+        parcel->writeInt64Vector(values);
+        parcel->writeString16(name);
+        parcel->writeParcelableVector(children);
+        const size_t end = parcel->dataPosition();
+        parcel->setDataPosition(start);
+        parcel->writeInt32(static_cast<int32_t>(end - start));
+        parcel->setDataPosition(end);
+        return OK;
+    }
+
+    status_t readFromParcel(const Parcel*) override { return INVALID_OPERATION; }
+
+private:
+    std::vector<int64_t> values;
+    String16 name;
+    std::vector<Nested> children;
+};
+
+struct Case {
+    std::string name;
+    // Called once before timing, e.g. to fill a Parcel that is read back.
+    std::function<void()> setup;
+    std::function<void()> op;
+    // Elements one op() handles. The iterations are split between them and
+    // the numbers are reported per element.
+    size_t weight = 1;
+};
+
+struct Options {
+    std::string filter;
+    size_t iterations = 200000;
+    size_t warmup = 10000;
+};
+
+static void usage(const char* prog) {
+    printf("Usage: %s [options]\n"
+           "\n"
+           "  --filter TEXT       only run cases whose name contains TEXT\n"
+           "  --iterations N      timed operations per case (default: 200000)\n"
+           "  --warmup N          untimed operations per case (default: 10000)\n"
+           "  --list              print case names and exit\n",
+           prog);
+}
+
+static void runCase(const Case& c, const Options& opts) {
+    if (c.setup) c.setup();
+    const size_t warmup = opts.warmup / c.weight;
+    const size_t iterations = std::max<size_t>(opts.iterations / c.weight, 1);
+    for (size_t i = 0; i < warmup; i++) {
+        c.op();
+    }
+
+    gAllocs = 0;
+    gAllocBytes = 0;
+    gCounting = true;
+    nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    for (size_t i = 0; i < iterations; i++) {
+        c.op();
+    }
+    nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - start;
+    gCounting = false;
+
+    double n = static_cast<double>(iterations) * c.weight;
+    printf("%-40s %12.1f %12.2f %12.1f\n", c.name.c_str(), elapsed / n, gAllocs / n,
+           gAllocBytes / n);
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option longOptions[] = {
+            {"filter", required_argument, nullptr, 'f'},
+            {"iterations", required_argument, nullptr, 'n'},
+            {"warmup", required_argument, nullptr, 'w'},
+            {"list", no_argument, nullptr, 'l'},
+            {"help", no_argument, nullptr, 'h'},
+            {nullptr, 0, nullptr, 0},
+    };
+
+    Options opts;
+    bool list = false;
+    int c;
+    while ((c = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+        switch (c) {
+            case 'f': opts.filter = optarg; break;
+            case 'n': opts.iterations = strtoull(optarg, nullptr, 0); break;
+            case 'w': opts.warmup = strtoull(optarg, nullptr, 0); break;
+            case 'l': list = true; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (opts.iterations == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    const String16 shortString16(u"hello binder");
+    const String16 longString16(std::u16string(1024, u'x').c_str());
+    const std::string shortUtf8("hello binder");
+    const std::string longUtf8(1024, 'x');
+    const std::string nonAsciiUtf8 = [] {
+        std::string s;
+        while (s.size() < 1024) s += "\xea\xb0\x80\xe2\x82\xac\xf0\x9f\x98\x80";
+        return s;
+    }();
+    const std::vector<uint8_t> bytes4k(4096, 0x5a);
+    const std::vector<int32_t> ints1k(1024, 0x12345678);
+    const std::vector<int64_t> longs1k(1024, 0x123456789abcdefll);
+    const std::vector<bool> bools1k(1024, true);
+    const std::vector<char16_t> chars1k(1024, u'y');
+    const std::vector<bool> bools100k(100000, true);
+    const std::vector<char16_t> chars100k(100000, u'y');
+    const std::vector<String16> strings64(64, shortString16);
+    const Nested nested(2, 64);
+    const sp<IBinder> binder = sp<BBinder>::make();
+    const int fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+
+    // Writers reuse one Parcel and rewind it, so the numbers are the cost of
+    // the write itself and not of growing the buffer. The "fresh" cases show
+    // what a per-call Parcel costs instead.
+    Parcel w;
+    auto writer = [&w](std::function<void(Parcel&)> fn) {
+        return [&w, fn] {
+            w.setDataPosition(0);
+            fn(w);
+        };
+    };
+
+    // Readers share one Parcel that the setup step fills with a single value.
+    Parcel r;
+    auto filler = [&r](std::function<void(Parcel&)> fn) {
+        return [&r, fn] {
+            r.freeData();
+            fn(r);
+        };
+    };
+    auto reader = [&r](std::function<void(const Parcel&)> fn) {
+        return [&r, fn] {
+            r.setDataPosition(0);
+            fn(r);
+        };
+    };
+
+    std::vector<Case> cases = {
+            {"write/Int32", nullptr, writer([](Parcel& p) { p.writeInt32(42); })},
+            {"write/Int64", nullptr, writer([](Parcel& p) { p.writeInt64(42); })},
+            {"write/String16/short", nullptr,
+             writer([&](Parcel& p) { p.writeString16(shortString16); })},
+            {"write/String16/1k", nullptr,
+             writer([&](Parcel& p) { p.writeString16(longString16); })},
+            {"write/Utf8AsUtf16/short", nullptr,
+             writer([&](Parcel& p) { p.writeUtf8AsUtf16(shortUtf8); })},
+            {"write/Utf8AsUtf16/1k", nullptr,
+             writer([&](Parcel& p) { p.writeUtf8AsUtf16(longUtf8); })},
+            {"write/Utf8AsUtf16/1k-nonascii", nullptr,
+             writer([&](Parcel& p) { p.writeUtf8AsUtf16(nonAsciiUtf8); })},
+            // Objects are never released by a rewind, use a fresh Parcel.
+            {"write/StrongBinder", nullptr,
+             [&] {
+                 Parcel p;
+                 p.writeStrongBinder(binder);
+             }},
+            {"write/FileDescriptor", nullptr,
+             [&] {
+                 Parcel p;
+                 p.writeFileDescriptor(fd, false /*takeOwnership*/);
+             }},
+            {"write/ByteVector/4k", nullptr,
+             writer([&](Parcel& p) { p.writeByteVector(bytes4k); })},
+            {"write/Int32Vector/1k", nullptr,
+             writer([&](Parcel& p) { p.writeInt32Vector(ints1k); })},
+            {"write/Int64Vector/1k", nullptr,
+             writer([&](Parcel& p) { p.writeInt64Vector(longs1k); })},
+            {"write/BoolVector/1k", nullptr,
+             writer([&](Parcel& p) { p.writeBoolVector(bools1k); })},
+            {"write/CharVector/1k", nullptr,
+             writer([&](Parcel& p) { p.writeCharVector(chars1k); })},
+            {"write/BoolVector/100k", nullptr,
+             writer([&](Parcel& p) { p.writeBoolVector(bools100k); })},
+            {"write/CharVector/100k", nullptr,
+             writer([&](Parcel& p) { p.writeCharVector(chars100k); })},
+            {"write/String16Vector/64", nullptr,
+             writer([&](Parcel& p) { p.writeString16Vector(strings64); })},
+            {"fresh/Int32", nullptr,
+             [] {
+                 Parcel p;
+                 p.writeInt32(42);
+             }},
+            {"fresh/ByteVector/4k", nullptr,
+             [&] {
+                 Parcel p;
+                 p.writeByteVector(bytes4k);
+             }},
+            {"fresh/Parcelable/nested", nullptr,
+             [&] {
+                 Parcel p;
+                 p.writeParcelable(nested);
+             }},
+            {"fresh/Parcelable/nested-sized", nullptr,
+             [&] {
+                 Parcel p;
+                 ParcelSizing::writeParcelable(&p, nested);
+             }},
+
+            {"read/Int32", filler([](Parcel& p) { p.writeInt32(42); }),
+             reader([](const Parcel& p) { doNotOptimize(p.readInt32()); })},
+            {"read/Int64", filler([](Parcel& p) { p.writeInt64(42); }),
+             reader([](const Parcel& p) { doNotOptimize(p.readInt64()); })},
+            {"read/String16/short", filler([&](Parcel& p) { p.writeString16(shortString16); }),
+             reader([](const Parcel& p) { doNotOptimize(p.readString16()); })},
+            {"read/String16/1k", filler([&](Parcel& p) { p.writeString16(longString16); }),
+             reader([](const Parcel& p) { doNotOptimize(p.readString16()); })},
+            {"read/Utf8FromUtf16/short", filler([&](Parcel& p) { p.writeUtf8AsUtf16(shortUtf8); }),
+             reader([](const Parcel& p) {
+                 std::string s;
+                 p.readUtf8FromUtf16(&s);
+                 doNotOptimize(s);
+             })},
+            {"read/Utf8FromUtf16/1k", filler([&](Parcel& p) { p.writeUtf8AsUtf16(longUtf8); }),
+             reader([](const Parcel& p) {
+                 std::string s;
+                 p.readUtf8FromUtf16(&s);
+                 doNotOptimize(s);
+             })},
+            {"read/Utf8FromUtf16/1k-nonascii",
+             filler([&](Parcel& p) { p.writeUtf8AsUtf16(nonAsciiUtf8); }),
+             reader([](const Parcel& p) {
+                 std::string s;
+                 p.readUtf8FromUtf16(&s);
+                 doNotOptimize(s);
+             })},
+            {"read/StrongBinder", filler([&](Parcel& p) { p.writeStrongBinder(binder); }),
+             reader([](const Parcel& p) { doNotOptimize(p.readStrongBinder()); })},
+            {"read/FileDescriptor",
+             filler([&](Parcel& p) { p.writeFileDescriptor(fd, false /*takeOwnership*/); }),
+             reader([](const Parcel& p) { doNotOptimize(p.readFileDescriptor()); })},
+            {"read/ByteVector/4k", filler([&](Parcel& p) { p.writeByteVector(bytes4k); }),
+             reader([](const Parcel& p) {
+                 std::vector<uint8_t> v;
+                 p.readByteVector(&v);
+                 doNotOptimize(v);
+             })},
+            {"read/Int32Vector/1k", filler([&](Parcel& p) { p.writeInt32Vector(ints1k); }),
+             reader([](const Parcel& p) {
+                 std::vector<int32_t> v;
+                 p.readInt32Vector(&v);
+                 doNotOptimize(v);
+             })},
+            {"read/Int64Vector/1k", filler([&](Parcel& p) { p.writeInt64Vector(longs1k); }),
+             reader([](const Parcel& p) {
+                 std::vector<int64_t> v;
+                 p.readInt64Vector(&v);
+                 doNotOptimize(v);
+             })},
+            {"read/BoolVector/1k", filler([&](Parcel& p) { p.writeBoolVector(bools1k); }),
+             reader([](const Parcel& p) {
+                 std::vector<bool> v;
+                 p.readBoolVector(&v);
+                 doNotOptimize(v);
+             })},
+            {"read/CharVector/1k", filler([&](Parcel& p) { p.writeCharVector(chars1k); }),
+             reader([](const Parcel& p) {
+                 std::vector<char16_t> v;
+                 p.readCharVector(&v);
+                 doNotOptimize(v);
+             })},
+            {"read/BoolVector/100k", filler([&](Parcel& p) { p.writeBoolVector(bools100k); }),
+             reader([](const Parcel& p) {
+                 std::vector<bool> v;
+                 p.readBoolVector(&v);
+                 doNotOptimize(v);
+             })},
+            {"read/CharVector/100k", filler([&](Parcel& p) { p.writeCharVector(chars100k); }),
+             reader([](const Parcel& p) {
+                 std::vector<char16_t> v;
+                 p.readCharVector(&v);
+                 doNotOptimize(v);
+             })},
+            {"read/String16Vector/64", filler([&](Parcel& p) { p.writeString16Vector(strings64); }),
+             reader([](const Parcel& p) {
+                 std::vector<String16> v;
+                 p.readString16Vector(&v);
+                 doNotOptimize(v);
+             })},
+    };
+
+    // Parcels carrying many objects, read the way generated code does: every
+    // element is a parcelable with a size prefix that is skipped with
+    // setDataPosition(). Each read is checked against the object offsets.
+    std::vector<std::unique_ptr<Parcel>> objectParcels;
+    for (size_t count : {1, 10, 100, 1000, 10000}) {
+        Parcel* binders = objectParcels.emplace_back(std::make_unique<Parcel>()).get();
+        cases.push_back({"read/BinderParcelables/" + std::to_string(count),
+                         [binders, count, &binder] {
+                             binders->freeData();
+                             for (size_t i = 0; i < count; i++) {
+                                 const size_t start = binders->dataPosition();
+                                 binders->writeInt32(0);
+                                 binders->writeStrongBinder(binder);
+                                 const size_t end = binders->dataPosition();
+                                 binders->setDataPosition(start);
+                                 binders->writeInt32(static_cast<int32_t>(end - start));
+                                 binders->setDataPosition(end);
+                             }
+                         },
+                         [binders, count] {
+                             binders->setDataPosition(0);
+                             for (size_t i = 0; i < count; i++) {
+                                 const size_t start = binders->dataPosition();
+                                 int32_t size = 0;
+                                 binders->readInt32(&size);
+                                 doNotOptimize(binders->readStrongBinder());
+                                 binders->setDataPosition(start + size);
+                             }
+                         },
+                         count});
+
+        Parcel* fds = objectParcels.emplace_back(std::make_unique<Parcel>()).get();
+        cases.push_back({"read/FileDescriptors/" + std::to_string(count),
+                         [fds, count, fd] {
+                             fds->freeData();
+                             for (size_t i = 0; i < count; i++) {
+                                 fds->writeInt32(static_cast<int32_t>(i));
+                                 fds->writeFileDescriptor(fd, false /*takeOwnership*/);
+                             }
+                         },
+                         [fds, count] {
+                             fds->setDataPosition(0);
+                             for (size_t i = 0; i < count; i++) {
+                                 doNotOptimize(fds->readInt32());
+                                 doNotOptimize(fds->readFileDescriptor());
+                             }
+                         },
+                         count});
+    }
+
+    if (!list) {
+        printf("%-40s %12s %12s %12s\n", "case", "ns/op", "allocs/op", "bytes/op");
+    }
+    for (const Case& c : cases) {
+        if (!opts.filter.empty() && c.name.find(opts.filter) == std::string::npos) continue;
+        if (list) {
+            printf("%s\n", c.name.c_str());
+            continue;
+        }
+        runCase(c, opts);
+    }
+
+    r.freeData();
+    objectParcels.clear();
+    close(fd);
+    return 0;
+}
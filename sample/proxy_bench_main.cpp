@@ -0,0 +1,221 @@
+#define LOG_TAG "ProxyBench"
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <binder/Binder.h>
+#include <binder/IPCThreadState.h>
+#include <binder/IServiceManager.h>
+#include <binder/Parcel.h>
+#include <binder/ProcessState.h>
+
+#include <utils/Timers.h>
+
+using namespace android;
+
+// proxy_bench measures how readStrongBinder() scales with the number of
+// threads unparceling binders at once. Every read of a remote binder looks
+// its proxy up in ProcessState. A child process publishes the services whose
+// proxies are read; after fetching them once, the client only works on
+// Parcels of its own and does not talk to the driver.
+
+struct Options {
+    std::string driver;
+    std::vector<size_t> threads = {1, 2, 4, 8, 16, 32};
+    size_t services = 8;
+    size_t binders = 64;
+    nsecs_t duration = ms2ns(1000);
+};
+
+static void usage(const char* prog) {
+    printf("Usage: %s [client|server] [options]\n"
+           "\n"
+           "  --driver PATH       binder device (default: /dev/binder)\n"
+           "  --threads A,B,...   reader thread counts (default: 1,2,4,8,16,32)\n"
+           "  --services N        distinct proxies in every Parcel (default: 8)\n"
+           "  --binders N         binders per Parcel (default: 64)\n"
+           "  --duration MS       time per thread count (default: 1000)\n",
+           prog);
+}
+
+static bool parseList(const char* arg, std::vector<size_t>* out) {
+    out->clear();
+    std::string list(arg);
+    size_t pos = 0;
+    while (pos <= list.size()) {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos) end = list.size();
+        std::string item = list.substr(pos, end - pos);
+        char* last = nullptr;
+        unsigned long long value = strtoull(item.c_str(), &last, 0);
+        if (item.empty() || *last != '\0' || value == 0) return false;
+        out->push_back(static_cast<size_t>(value));
+        pos = end + 1;
+    }
+    return !out->empty();
+}
+
+static std::string serviceName(pid_t client, size_t index) {
+    return "proxy.bench." + std::to_string(client) + "." + std::to_string(index);
+}
+
+static int runServer(const Options& opts, pid_t client) {
+    if (!opts.driver.empty()) ProcessState::initWithDriver(opts.driver.c_str());
+    sp<IServiceManager> sm = defaultServiceManager();
+    for (size_t i = 0; i < opts.services; i++) {
+        std::string name = serviceName(client, i);
+        if (sm->addService(String16(name.c_str()), sp<BBinder>::make()) != NO_ERROR) {
+            fprintf(stderr, "Failed addService(%s)\n", name.c_str());
+            return 1;
+        }
+    }
+    IPCThreadState::self()->joinThreadPool();
+    return 0;
+}
+
+static pid_t spawnServer(const Options& opts) {
+    std::string clientArg = std::to_string(getpid());
+    std::string servicesArg = std::to_string(opts.services);
+    std::vector<const char*> args = {"proxy_bench", "server", "--client", clientArg.c_str(),
+                                     "--services", servicesArg.c_str()};
+    if (!opts.driver.empty()) {
+        args.push_back("--driver");
+        args.push_back(opts.driver.c_str());
+    }
+    args.push_back(nullptr);
+
+    // The child must not touch binder between fork() and exec().
+    pid_t pid = fork();
+    if (pid == 0) {
+        execv("/proc/self/exe", const_cast<char* const*>(args.data()));
+        _exit(127);
+    }
+    return pid;
+}
+
+// Unparcels binders on |threads| threads for opts.duration and returns the
+// reads per second.
+static double runCase(const Options& opts, const std::vector<sp<IBinder>>& proxies,
+                      size_t threads) {
+    std::atomic<bool> start{false};
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> reads{0};
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; t++) {
+        workers.emplace_back([&] {
+            Parcel parcel;
+            for (size_t i = 0; i < opts.binders; i++) {
+                parcel.writeStrongBinder(proxies[i % proxies.size()]);
+            }
+            uint64_t count = 0;
+            while (!start.load(std::memory_order_acquire)) std::this_thread::yield();
+            while (!stop.load(std::memory_order_relaxed)) {
+                parcel.setDataPosition(0);
+                for (size_t i = 0; i < opts.binders; i++) {
+                    sp<IBinder> binder = parcel.readStrongBinder();
+                    if (binder == nullptr) abort();
+                }
+                count += opts.binders;
+            }
+            reads.fetch_add(count, std::memory_order_relaxed);
+        });
+    }
+
+    nsecs_t begin = systemTime(SYSTEM_TIME_MONOTONIC);
+    start.store(true, std::memory_order_release);
+    std::this_thread::sleep_for(std::chrono::nanoseconds(opts.duration));
+    stop.store(true, std::memory_order_relaxed);
+    for (std::thread& worker : workers) worker.join();
+    nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - begin;
+    return reads.load() * 1e9 / elapsed;
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option longOptions[] = {
+            {"driver", required_argument, nullptr, 'd'},
+            {"threads", required_argument, nullptr, 't'},
+            {"services", required_argument, nullptr, 's'},
+            {"binders", required_argument, nullptr, 'b'},
+            {"duration", required_argument, nullptr, 'D'},
+            {"client", required_argument, nullptr, 'c'},
+            {"help", no_argument, nullptr, 'h'},
+            {nullptr, 0, nullptr, 0},
+    };
+
+    Options opts;
+    bool server = false;
+    pid_t client = 0;
+    if (argc > 1 && argv[1][0] != '-') {
+        if (!strcmp(argv[1], "server")) {
+            server = true;
+        } else if (strcmp(argv[1], "client")) {
+            usage(argv[0]);
+            return 1;
+        }
+        optind = 2;
+    }
+
+    int c;
+    while ((c = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+        bool ok = true;
+        switch (c) {
+            case 'd': opts.driver = optarg; break;
+            case 't': ok = parseList(optarg, &opts.threads); break;
+            case 's': opts.services = strtoull(optarg, nullptr, 0); break;
+            case 'b': opts.binders = strtoull(optarg, nullptr, 0); break;
+            case 'D': opts.duration = ms2ns(strtoll(optarg, nullptr, 0)); break;
+            case 'c': client = atoi(optarg); break;
+            default: ok = false; break;
+        }
+        if (!ok || opts.services == 0 || opts.binders == 0) {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+    if (server) return runServer(opts, client);
+
+    if (!opts.driver.empty()) ProcessState::initWithDriver(opts.driver.c_str());
+    ProcessState::self()->setThreadPoolMaxThreadCount(0);
+
+    pid_t pid = spawnServer(opts);
+    if (pid < 0) {
+        fprintf(stderr, "%s - Failed to spawn server\n", strerror(errno));
+        return 1;
+    }
+
+    std::vector<sp<IBinder>> proxies;
+    sp<IServiceManager> sm = defaultServiceManager();
+    for (size_t i = 0; i < opts.services; i++) {
+        sp<IBinder> proxy = sm->waitForService(String16(serviceName(getpid(), i).c_str()));
+        if (proxy == nullptr) {
+            fprintf(stderr, "Failed to get service %s\n", serviceName(getpid(), i).c_str());
+            kill(pid, SIGTERM);
+            waitpid(pid, nullptr, 0);
+            return 1;
+        }
+        proxies.push_back(proxy);
+    }
+
+    printf("%8s %16s %12s\n", "threads", "reads/s", "ns/read");
+    for (size_t threads : opts.threads) {
+        double rate = runCase(opts, proxies, threads);
+        printf("%8zu %16.0f %12.1f\n", threads, rate, threads * 1e9 / rate);
+    }
+
+    proxies.clear();
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+    return 0;
+}
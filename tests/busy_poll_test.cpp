@@ -0,0 +1,67 @@
+#define LOG_TAG "BusyPollTest"
+
+#include <unistd.h>
+
+#include <binder/BusyPoll.h>
+#include <gtest/gtest.h>
+#include <utils/Timers.h>
+
+using namespace android;
+
+// BusyPoll without a driver, spinning on a pipe in place of the binder fd:
+// the limits of a policy are kept in order and a spin ends on input or
+// after its budget.
+
+class BusyPollTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        saved = BusyPoll::getPolicy();
+        ASSERT_EQ(pipe(fds), 0);
+    }
+
+    void TearDown() override {
+        BusyPoll::setPolicy(saved);
+        close(fds[0]);
+        close(fds[1]);
+    }
+
+    static BusyPoll::Policy policy(nsecs_t minSpin, nsecs_t maxSpin) {
+        BusyPoll::Policy p;
+        p.minSpin = minSpin;
+        p.maxSpin = maxSpin;
+        return p;
+    }
+
+    BusyPoll::Policy saved;
+    int fds[2] = {-1, -1};
+};
+
+TEST_F(BusyPollTest, SwapsLimits) {
+    // What BINDER_BUSY_POLL=10,20 asks for.
+    BusyPoll::setPolicy(policy(us2ns(20), us2ns(10)));
+    EXPECT_EQ(BusyPoll::getPolicy().minSpin, us2ns(10));
+    EXPECT_EQ(BusyPoll::getPolicy().maxSpin, us2ns(20));
+
+    // Spinning with them must not reach std::clamp() with lo > hi.
+    const nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    BusyPoll::spin(fds[0]);
+    BusyPoll::woke();
+    EXPECT_LT(systemTime(SYSTEM_TIME_MONOTONIC) - start, ms2ns(100));
+}
+
+TEST_F(BusyPollTest, ZeroMaximumDisables) {
+    BusyPoll::setPolicy(policy(us2ns(20), 0));
+    EXPECT_FALSE(BusyPoll::isEnabled());
+    EXPECT_EQ(BusyPoll::getPolicy().minSpin, 0);
+}
+
+TEST_F(BusyPollTest, SpinEndsOnInput) {
+    BusyPoll::setPolicy(policy(s2ns(10), s2ns(10)));
+    ASSERT_EQ(write(fds[1], "x", 1), 1);
+    const BusyPoll::Stats before = BusyPoll::stats();
+    const nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+    BusyPoll::spin(fds[0]);
+    BusyPoll::woke();
+    EXPECT_LT(systemTime(SYSTEM_TIME_MONOTONIC) - start, s2ns(1)) << "spun past the input";
+    EXPECT_EQ(BusyPoll::stats().hits, before.hits + 1);
+}
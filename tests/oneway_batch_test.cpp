@@ -0,0 +1,221 @@
+#define LOG_TAG "OnewayBatchTest"
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+#include <binder/Binder.h>
+#include <binder/IPCThreadState.h>
+#include <binder/IServiceManager.h>
+#include <binder/OnewayBatch.h>
+#include <binder/Parcel.h>
+#include <binder/ProcessState.h>
+
+using namespace android;
+
+// binder_oneway_batch_test checks that a failed call in the middle of an
+// OnewayBatch does not take the rest of the batch down with it. The driver
+// stops reading the write buffer at the first transaction that fails, so
+// the calls queued behind it have to be sent again.
+//
+// A "full" server blocks in its first oneway call, so further oneway calls
+// pile up in its async buffer space until the driver fails them. A batch of
+// calls to a "live" server with one call to the full server in the middle
+// must then report the failure and still deliver every call to the live
+// server.
+
+enum {
+    SINK_TRANSACTION = IBinder::FIRST_CALL_TRANSACTION,
+    COUNT_TRANSACTION,
+    BLOCK_TRANSACTION,
+};
+
+// Payload of the calls that fill up the full server.
+constexpr size_t kFillSize = 64 * 1024;
+// Gives up filling after this many calls, well past the default async space.
+constexpr size_t kMaxFill = 64;
+
+struct Options {
+    std::string driver;
+    size_t calls = 16;
+};
+
+class Counter : public BBinder {
+    status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply,
+                        uint32_t flags) override {
+        switch (code) {
+            case SINK_TRANSACTION:
+                mCount++;
+                return NO_ERROR;
+            case COUNT_TRANSACTION:
+                return reply->writeInt32(mCount);
+            case BLOCK_TRANSACTION:
+                // Never returns; the server is killed at the end.
+                while (true) pause();
+            default:
+                return BBinder::onTransact(code, data, reply, flags);
+        }
+    }
+
+    int32_t mCount = 0;
+};
+
+static void usage(const char* prog) {
+    printf("Usage: %s [options]\n"
+           "\n"
+           "  --driver PATH       binder device (default: /dev/binder)\n"
+           "  --calls N           calls to the live server per batch (default: 16)\n",
+           prog);
+}
+
+static int runServer(const std::string& name) {
+    // One thread: a blocked call stalls every later oneway call.
+    ProcessState::self()->setThreadPoolMaxThreadCount(0);
+    if (defaultServiceManager()->addService(String16(name.c_str()), sp<Counter>::make()) !=
+        NO_ERROR) {
+        fprintf(stderr, "Failed addService(%s)\n", name.c_str());
+        return 1;
+    }
+    IPCThreadState::self()->joinThreadPool();
+    return 0;
+}
+
+static pid_t spawnServer(const Options& opts, const std::string& name) {
+    std::vector<const char*> args = {"binder_oneway_batch_test", "--server", name.c_str()};
+    if (!opts.driver.empty()) {
+        args.push_back("--driver");
+        args.push_back(opts.driver.c_str());
+    }
+    args.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        execv("/proc/self/exe", const_cast<char* const*>(args.data()));
+        _exit(127);
+    }
+    return pid;
+}
+
+// Like waitForService(), but gives up when the server exits.
+static sp<IBinder> waitForServer(pid_t pid, const std::string& name) {
+    while (true) {
+        sp<IBinder> binder = defaultServiceManager()->checkService(String16(name.c_str()));
+        if (binder != nullptr) return binder;
+        if (waitpid(pid, nullptr, WNOHANG) != 0) return nullptr;
+        usleep(10000);
+    }
+}
+
+static status_t sendOneway(const sp<IBinder>& binder, uint32_t code, size_t size) {
+    Parcel data;
+    std::vector<uint8_t> payload(size);
+    data.writeByteVector(payload);
+    return binder->transact(code, data, nullptr, IBinder::FLAG_ONEWAY);
+}
+
+static int32_t count(const sp<IBinder>& binder) {
+    Parcel data, reply;
+    if (binder->transact(COUNT_TRANSACTION, data, &reply) != NO_ERROR) return -1;
+    return reply.readInt32();
+}
+
+// Blocks |full| and fills its async space. Returns whether a call failed.
+static bool fill(const sp<IBinder>& full) {
+    if (sendOneway(full, BLOCK_TRANSACTION, 0) != NO_ERROR) return false;
+    for (size_t i = 0; i < kMaxFill; i++) {
+        if (sendOneway(full, SINK_TRANSACTION, kFillSize) != NO_ERROR) return true;
+    }
+    return false;
+}
+
+static bool runBatch(const sp<IBinder>& live, const sp<IBinder>& full, const Options& opts,
+                     int32_t expected) {
+    status_t err;
+    {
+        OnewayBatch batch;
+        for (size_t i = 0; i < opts.calls; i++) sendOneway(live, SINK_TRANSACTION, 4);
+        sendOneway(full, SINK_TRANSACTION, kFillSize);
+        for (size_t i = 0; i < opts.calls; i++) sendOneway(live, SINK_TRANSACTION, 4);
+        err = batch.flush();
+    }
+    // The two-way call only gets its own reply if the batch left the
+    // driver's answers in step.
+    int32_t delivered = count(live);
+    printf("batch: flush %d, live server got %d of %d calls\n", err, delivered, expected);
+    if (err != FAILED_TRANSACTION) {
+        printf("FAIL: flush() did not report the failed call\n");
+        return false;
+    }
+    if (delivered != expected) {
+        printf("FAIL: calls behind the failed one were lost\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option longOptions[] = {
+            {"driver", required_argument, nullptr, 'd'},
+            {"calls", required_argument, nullptr, 'n'},
+            {"server", required_argument, nullptr, 'S'},
+            {"help", no_argument, nullptr, 'h'},
+            {nullptr, 0, nullptr, 0},
+    };
+
+    Options opts;
+    std::string serverName;
+    int c;
+    while ((c = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+        switch (c) {
+            case 'd': opts.driver = optarg; break;
+            case 'n': opts.calls = strtoull(optarg, nullptr, 0); break;
+            case 'S': serverName = optarg; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (!opts.driver.empty()) {
+        ProcessState::initWithDriver(opts.driver.c_str());
+    }
+    if (!serverName.empty()) {
+        return runServer(serverName);
+    }
+
+    ProcessState::self()->setThreadPoolMaxThreadCount(0);
+    const std::string prefix = "binder.batch." + std::to_string(getpid());
+    const std::string liveName = prefix + ".live", fullName = prefix + ".full";
+    pid_t livePid = spawnServer(opts, liveName);
+    pid_t fullPid = spawnServer(opts, fullName);
+    if (livePid < 0 || fullPid < 0) {
+        fprintf(stderr, "%s - Failed to spawn servers\n", strerror(errno));
+        return 1;
+    }
+    sp<IBinder> live = waitForServer(livePid, liveName);
+    sp<IBinder> full = waitForServer(fullPid, fullName);
+
+    int result = 1;
+    if (live == nullptr || full == nullptr) {
+        fprintf(stderr, "Failed to get services\n");
+    } else if (!fill(full)) {
+        printf("FAIL: could not fill the server's async space\n");
+    } else if (runBatch(live, full, opts, 2 * opts.calls) &&
+               runBatch(live, full, opts, 4 * opts.calls)) {
+        printf("PASS\n");
+        result = 0;
+    }
+    for (pid_t pid : {livePid, fullPid}) {
+        kill(pid, SIGTERM);
+        waitpid(pid, nullptr, 0);
+    }
+    return result;
+}
@@ -0,0 +1,118 @@
+#define LOG_TAG "ParcelAllocTest"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <thread>
+#include <vector>
+
+#include <binder/Parcel.h>
+#include <binder/ParcelStorage.h>
+#include <gtest/gtest.h>
+#include <utils/String16.h>
+
+using namespace android;
+
+// Echo-style calls must reach a steady state without heap allocations: a
+// data Parcel is written and read back, a reply Parcel is written and read
+// back, both are destroyed, repeat. After a warm-up the ParcelStorage cache
+// of the thread must serve every buffer.
+//
+// Allocations are counted by interposing the glibc malloc family, as
+// parcel_bench does.
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+}
+
+static thread_local bool tCounting = false;
+static thread_local size_t tAllocs = 0;
+
+extern "C" void* malloc(size_t size) {
+    if (tCounting) tAllocs++;
+    return __libc_malloc(size);
+}
+
+extern "C" void* calloc(size_t n, size_t size) {
+    if (tCounting) tAllocs++;
+    return __libc_calloc(n, size);
+}
+
+extern "C" void* realloc(void* ptr, size_t size) {
+    if (tCounting) tAllocs++;
+    return __libc_realloc(ptr, size);
+}
+
+extern "C" void free(void* ptr) {
+    __libc_free(ptr);
+}
+
+constexpr size_t kWarmup = 100;
+constexpr size_t kIterations = 10000;
+
+static const String16 kDescriptor(u"android.test.IEcho");
+
+// One call carrying |size| payload bytes each way. The descriptor stands in
+// for the interface token, which would need a driver.
+static bool echo(size_t size, const std::vector<uint8_t>& payload) {
+    Parcel data;
+    data.writeString16(kDescriptor);
+    data.writeInt32(static_cast<int32_t>(size));
+    data.write(payload.data(), size);
+    data.writeInt64(42);
+
+    data.setDataPosition(0);
+    size_t descriptorLen = 0;
+    const char16_t* descriptor = data.readString16Inplace(&descriptorLen);
+    if (descriptor == nullptr || descriptorLen != kDescriptor.size()) return false;
+    const int32_t len = data.readInt32();
+    const void* in = data.readInplace(len);
+    if (in == nullptr || data.readInt64() != 42) return false;
+
+    Parcel reply;
+    reply.writeInt32(0);  // status
+    reply.writeInt32(len);
+    reply.write(in, len);
+
+    reply.setDataPosition(0);
+    return reply.readInt32() == 0 && reply.readInt32() == len && reply.readInplace(len) != nullptr;
+}
+
+static void runSize(size_t size) {
+    std::vector<uint8_t> payload(size, 0x5a);
+    for (size_t i = 0; i < kWarmup; i++) {
+        ASSERT_TRUE(echo(size, payload)) << "echo of " << size << " bytes";
+    }
+
+    const ParcelStorage::Stats before = ParcelStorage::stats();
+    tAllocs = 0;
+    tCounting = true;
+    for (size_t i = 0; i < kIterations; i++) {
+        echo(size, payload);
+    }
+    tCounting = false;
+    const ParcelStorage::Stats after = ParcelStorage::stats();
+
+    printf("%8zu bytes: %8.3f allocs/call, %8.3f cache hits/call\n", size,
+           static_cast<double>(tAllocs) / kIterations,
+           static_cast<double>(after.hits - before.hits) / kIterations);
+    // Too large to be cached; reported only.
+    if (size * 2 > ParcelStorage::kMaxCached) return;
+    EXPECT_EQ(tAllocs, 0u) << "allocations in steady state, " << size << " bytes";
+}
+
+TEST(ParcelAllocTest, SteadyStateDoesNotAllocate) {
+    if (const char* value = getenv("BINDER_PARCEL_CACHE"); value != nullptr && !strcmp(value, "0")) {
+        GTEST_SKIP() << "BINDER_PARCEL_CACHE=0";
+    }
+
+    // Also on a fresh thread, which starts with an empty cache.
+    std::thread([] {
+        for (size_t size : {0, 16, 100, 1000, 4000, 16000}) runSize(size);
+    }).join();
+    runSize(100000);
+}
@@ -0,0 +1,151 @@
+#define LOG_TAG "ParcelSpillTest"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include <binder/Parcel.h>
+#include <binder/ParcelSpill.h>
+#include <gtest/gtest.h>
+
+using namespace android;
+
+// ParcelSpill without a driver: which Parcels are spilled, that the
+// receiving side maps back the same data, that a memfd without the required
+// seals is refused, and that the transaction buffer of a received spill is
+// only released along with the mapping.
+//
+// The driver is stood in for by copying the spilled Parcel into a buffer
+// that plays the transaction buffer, with its own file descriptor.
+
+constexpr size_t kThreshold = 4096;
+
+static size_t gReleased = 0;
+static const uint8_t* gReleasedData = nullptr;
+
+static void countRelease(const uint8_t* data, size_t, const binder_size_t*, size_t) {
+    gReleased++;
+    gReleasedData = data;
+}
+
+static std::vector<uint8_t> payload(size_t size) {
+    std::vector<uint8_t> bytes(size);
+    for (size_t i = 0; i < size; i++) bytes[i] = static_cast<uint8_t>(i * 31 + 7);
+    return bytes;
+}
+
+static void writePayload(Parcel* parcel, size_t size) {
+    std::vector<uint8_t> bytes = payload(size);
+    parcel->write(bytes.data(), bytes.size());
+}
+
+// A received copy of a spilled Parcel, as the driver would deliver it.
+struct Received {
+    std::vector<uint64_t> buffer;
+    binder_size_t offset;
+    binder_transaction_data tr = {};
+
+    Received(const Parcel& spilled, int fd) : buffer((spilled.dataSize() + 7) / 8) {
+        memcpy(buffer.data(), spilled.data(), spilled.dataSize());
+        // The only object is the memfd, right behind the header.
+        offset = spilled.dataSize() - sizeof(flat_binder_object);
+        auto* object = reinterpret_cast<flat_binder_object*>(
+                reinterpret_cast<uint8_t*>(buffer.data()) + offset);
+        object->handle = fd;
+        tr.data_size = spilled.dataSize();
+        tr.offsets_size = sizeof(binder_size_t);
+        tr.data.ptr.buffer = reinterpret_cast<binder_uintptr_t>(buffer.data());
+        tr.data.ptr.offsets = reinterpret_cast<binder_uintptr_t>(&offset);
+    }
+
+    const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(buffer.data()); }
+};
+
+static int spilledFd(const Parcel& spilled) {
+    spilled.setDataPosition(spilled.dataSize() - sizeof(flat_binder_object));
+    int fd = spilled.readFileDescriptor();
+    spilled.setDataPosition(0);
+    return fd;
+}
+
+TEST(ParcelSpillTest, Threshold) {
+    ParcelSpill::setThreshold(kThreshold);
+    Parcel small, large, withFd;
+    writePayload(&small, kThreshold);
+    writePayload(&large, kThreshold + 4);
+    writePayload(&withFd, kThreshold + 4);
+    withFd.writeDupFileDescriptor(STDOUT_FILENO);
+
+    EXPECT_EQ(ParcelSpill::spill(small), nullptr) << "spilled a Parcel at the threshold";
+    EXPECT_NE(ParcelSpill::spill(large), nullptr) << "did not spill a Parcel above the threshold";
+    EXPECT_EQ(ParcelSpill::spill(withFd), nullptr) << "spilled a Parcel carrying a file descriptor";
+    ParcelSpill::setThreshold(0);
+    EXPECT_EQ(ParcelSpill::spill(large), nullptr) << "spilled with spilling disabled";
+    ParcelSpill::setThreshold(kThreshold);
+    ParcelSpill::release();
+}
+
+class ParcelSpillRoundTrip : public ::testing::TestWithParam<size_t> {};
+
+TEST_P(ParcelSpillRoundTrip, MapsBackTheData) {
+    const size_t size = GetParam();
+    ParcelSpill::setThreshold(kThreshold);
+    Parcel data;
+    writePayload(&data, size);
+    ParcelSpill::ReleaseGuard spillGuard;
+    const Parcel* spilled = ParcelSpill::spill(data);
+    ASSERT_NE(spilled, nullptr);
+
+    // A reply: mapped from the Parcel.
+    const uint8_t* mapped;
+    size_t mappedSize;
+    ASSERT_TRUE(ParcelSpill::map(*spilled, &mapped, &mappedSize)) << "cannot map a spilled reply";
+    const bool same = mappedSize == data.dataSize() && memcmp(mapped, data.data(), mappedSize) == 0;
+    ParcelSpill::unmap(mapped, mappedSize, nullptr, 0);
+    EXPECT_TRUE(same) << "spilled reply reads back different data";
+
+    // A transaction: mapped from the buffer, which is kept until the
+    // mapping goes.
+    Received received(*spilled, dup(spilledFd(*spilled)));
+    gReleased = 0;
+    ASSERT_TRUE(ParcelSpill::map(received.tr, countRelease, &mapped, &mappedSize))
+            << "cannot map a spilled transaction";
+    EXPECT_EQ(mappedSize, data.dataSize());
+    EXPECT_EQ(memcmp(mapped, data.data(), std::min(mappedSize, data.dataSize())), 0);
+    EXPECT_EQ(gReleased, 0u) << "transaction buffer released while its data is mapped";
+    ParcelSpill::unmap(mapped, mappedSize, nullptr, 0);
+    EXPECT_EQ(gReleased, 1u) << "transaction buffer not released with the mapping";
+    EXPECT_EQ(gReleasedData, received.data());
+}
+
+INSTANTIATE_TEST_SUITE_P(Sizes, ParcelSpillRoundTrip,
+                         ::testing::Values(kThreshold + 4, kThreshold * 16, size_t{1024 * 1024}));
+
+TEST(ParcelSpillTest, RefusesUnsealedMemfd) {
+    ParcelSpill::setThreshold(kThreshold);
+    Parcel data;
+    writePayload(&data, kThreshold * 2);
+    ParcelSpill::ReleaseGuard spillGuard;
+    const Parcel* spilled = ParcelSpill::spill(data);
+    ASSERT_NE(spilled, nullptr);
+
+    // Same size and contents, but the sender could still write to it.
+    int fd = memfd_create("unsealed", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(write(fd, data.data(), data.dataSize()), static_cast<ssize_t>(data.dataSize()));
+    Received received(*spilled, fd);
+    gReleased = 0;
+    const uint8_t* mapped;
+    size_t mappedSize;
+    if (ParcelSpill::map(received.tr, countRelease, &mapped, &mappedSize)) {
+        ADD_FAILURE() << "mapped an unsealed memfd";
+        ParcelSpill::unmap(mapped, mappedSize, nullptr, 0);
+    }
+    // Refused: the buffer stays with the caller, and so does the fd.
+    EXPECT_EQ(gReleased, 0u) << "released the buffer of a refused spill";
+    close(fd);
+}
@@ -0,0 +1,103 @@
+#define LOG_TAG "ParcelViewsTest"
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+#include <binder/Parcel.h>
+#include <binder/ParcelViews.h>
+#include <gtest/gtest.h>
+#include <utils/String16.h>
+#include <utils/String8.h>
+
+using namespace android;
+
+// ParcelViews without a driver: views read back what Parcel wrote, nulls
+// are consumed the way Parcel's own readers consume them, and lengths that
+// run past the data are refused.
+
+constexpr int32_t kMarker = 0x600d;
+
+// The value after the one just read.
+static bool markerFollows(const Parcel& parcel) {
+    int32_t marker;
+    return parcel.readInt32(&marker) == OK && marker == kMarker;
+}
+
+TEST(ParcelViewsTest, Values) {
+    Parcel parcel;
+    const std::vector<uint8_t> bytes = {1, 2, 3, 4, 5};
+    const std::vector<int32_t> ints = {-1, 0, 1 << 30};
+    parcel.writeByteVector(bytes);
+    parcel.writeInt32Vector(ints);
+    parcel.writeString16(String16(u"hello"));
+    parcel.writeString8(String8("world"));
+    parcel.writeInt32(kMarker);
+    parcel.setDataPosition(0);
+
+    ParcelSpan<uint8_t> byteView;
+    ParcelSpan<int32_t> intView;
+    std::u16string_view str16;
+    std::string_view str8;
+    ASSERT_EQ(ParcelViews::readBytes(parcel, &byteView), OK);
+    EXPECT_EQ(byteView.toVector(), bytes);
+    ASSERT_EQ(ParcelViews::readArray(parcel, &intView), OK);
+    EXPECT_EQ(intView.toVector(), ints);
+    ASSERT_EQ(ParcelViews::readString16(parcel, &str16), OK);
+    EXPECT_EQ(str16, u"hello");
+    ASSERT_EQ(ParcelViews::readString8(parcel, &str8), OK);
+    EXPECT_EQ(str8, "world");
+    EXPECT_TRUE(markerFollows(parcel)) << "data after the views";
+}
+
+// Every reader must leave the position behind the null it read.
+TEST(ParcelViewsTest, Nulls) {
+    Parcel parcel;
+    for (int i = 0; i < 5; i++) {
+        parcel.writeInt32(-1);
+        parcel.writeInt32(kMarker);
+    }
+    parcel.setDataPosition(0);
+
+    ParcelSpan<uint8_t> bytes;
+    std::optional<ParcelSpan<uint8_t>> optionalBytes = ParcelSpan<uint8_t>();
+    std::u16string_view str16;
+    std::optional<std::u16string_view> optionalStr16 = u"";
+    std::string_view str8;
+    EXPECT_EQ(ParcelViews::readBytes(parcel, &bytes), UNEXPECTED_NULL);
+    EXPECT_TRUE(markerFollows(parcel)) << "null bytes";
+    EXPECT_EQ(ParcelViews::readBytes(parcel, &optionalBytes), OK);
+    EXPECT_FALSE(optionalBytes.has_value());
+    EXPECT_TRUE(markerFollows(parcel)) << "optional null bytes";
+    EXPECT_EQ(ParcelViews::readString16(parcel, &str16), UNEXPECTED_NULL);
+    EXPECT_TRUE(markerFollows(parcel)) << "null String16";
+    EXPECT_EQ(ParcelViews::readString16(parcel, &optionalStr16), OK);
+    EXPECT_FALSE(optionalStr16.has_value());
+    EXPECT_TRUE(markerFollows(parcel)) << "optional null String16";
+    EXPECT_EQ(ParcelViews::readString8(parcel, &str8), UNEXPECTED_NULL);
+    EXPECT_TRUE(markerFollows(parcel)) << "null String8";
+}
+
+// A length that claims more than the Parcel holds.
+class ParcelViewsBounds : public ::testing::TestWithParam<int32_t> {};
+
+TEST_P(ParcelViewsBounds, RefusesLengthPastTheEnd) {
+    Parcel parcel;
+    parcel.writeInt32(GetParam());
+    parcel.writeInt32(kMarker);
+
+    ParcelSpan<uint8_t> bytes;
+    ParcelSpan<int32_t> ints;
+    std::u16string_view str16;
+    std::string_view str8;
+    parcel.setDataPosition(0);
+    EXPECT_EQ(ParcelViews::readBytes(parcel, &bytes), BAD_VALUE);
+    parcel.setDataPosition(0);
+    EXPECT_EQ(ParcelViews::readArray(parcel, &ints), BAD_VALUE);
+    parcel.setDataPosition(0);
+    EXPECT_EQ(ParcelViews::readString16(parcel, &str16), BAD_VALUE);
+    parcel.setDataPosition(0);
+    EXPECT_EQ(ParcelViews::readString8(parcel, &str8), BAD_VALUE);
+}
+
+INSTANTIATE_TEST_SUITE_P(Lengths, ParcelViewsBounds, ::testing::Values(8, 1000, 0x7fffffff));
@@ -0,0 +1,320 @@
+#define LOG_TAG "PriorityInversionTest"
+
+#include <errno.h>
+#include <getopt.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <binder/Binder.h>
+#include <binder/IPCThreadState.h>
+#include <binder/IServiceManager.h>
+#include <binder/Parcel.h>
+#include <binder/PriorityInheritance.h>
+#include <binder/ProcessState.h>
+#include <utils/Timers.h>
+
+using namespace android;
+
+// binder_priority_test measures priority inversion through binder. A
+// high-priority client calls a service that burns CPU for a fixed time,
+// first on an idle CPU and then with CPU hogs competing for it. Client,
+// server and hogs all share one CPU. If the server thread inherits the
+// client's priority, the hogs barely change the round trip; if not, the
+// client waits for the hogs.
+//
+// The server reports the policy and priority it ran the call with, which is
+// checked against what the kernel is expected to pass on:
+//   rt   - SCHED_FIFO callers make the server thread SCHED_FIFO
+//   nice - the caller's nice value is carried over
+// Needs CAP_SYS_NICE; without it the test is skipped.
+
+enum {
+    SPIN_TRANSACTION = IBinder::FIRST_CALL_TRANSACTION,
+};
+
+constexpr int kRtPriority = 50;
+constexpr int kNice = -10;
+
+struct Options {
+    std::string driver;
+    int cpu = 0;
+    size_t load = 4;
+    size_t iterations = 500;
+    nsecs_t work = us2ns(200);
+    double maxRatio = 3.0;
+};
+
+struct SchedInfo {
+    int32_t policy;
+    int32_t priority;
+    int32_t nice;
+};
+
+static SchedInfo currentSched() {
+    SchedInfo info;
+    sched_param param = {};
+    info.policy = sched_getscheduler(0) & ~SCHED_RESET_ON_FORK;
+    sched_getparam(0, &param);
+    info.priority = param.sched_priority;
+    info.nice = getpriority(PRIO_PROCESS, 0);
+    return info;
+}
+
+static const char* policyName(int policy) {
+    switch (policy) {
+        case SCHED_OTHER: return "SCHED_OTHER";
+        case SCHED_FIFO: return "SCHED_FIFO";
+        case SCHED_RR: return "SCHED_RR";
+        case SCHED_BATCH: return "SCHED_BATCH";
+        case SCHED_IDLE: return "SCHED_IDLE";
+    }
+    return "?";
+}
+
+class Spinner : public BBinder {
+protected:
+    status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply,
+                        uint32_t flags) override {
+        if (code != SPIN_TRANSACTION) return BBinder::onTransact(code, data, reply, flags);
+
+        // Sample while running the call, before the driver restores the
+        // thread's own priority.
+        SchedInfo info = currentSched();
+        const nsecs_t work = data.readInt64();
+        const nsecs_t end = systemTime(SYSTEM_TIME_THREAD) + work;
+        while (systemTime(SYSTEM_TIME_THREAD) < end) {
+        }
+        reply->writeInt32(info.policy);
+        reply->writeInt32(info.priority);
+        reply->writeInt32(info.nice);
+        return NO_ERROR;
+    }
+};
+
+static void usage(const char* prog) {
+    printf("Usage: %s [options]\n"
+           "\n"
+           "  --driver PATH       binder device (default: /dev/binder)\n"
+           "  --cpu N             CPU shared by client, server and load (default: 0)\n"
+           "  --load N            CPU hog threads (default: 4)\n"
+           "  --iterations N      calls per phase (default: 500)\n"
+           "  --work US           CPU time the server spends per call (default: 200)\n"
+           "  --max-ratio X       fail if loaded p99 exceeds idle p99 by X (default: 3)\n",
+           prog);
+}
+
+static int runServer(const std::string& name) {
+    ProcessState::self()->setThreadPoolMaxThreadCount(0);
+    sp<Spinner> spinner = sp<Spinner>::make();
+    spinner->setInheritRt(true);
+    if (defaultServiceManager()->addService(String16(name.c_str()), spinner) != NO_ERROR) {
+        fprintf(stderr, "Failed addService(%s)\n", name.c_str());
+        return 1;
+    }
+    IPCThreadState::self()->joinThreadPool();
+    return 0;
+}
+
+static pid_t spawnServer(const Options& opts, const std::string& name) {
+    std::vector<const char*> args = {"binder_priority_test", "--server", name.c_str()};
+    if (!opts.driver.empty()) {
+        args.push_back("--driver");
+        args.push_back(opts.driver.c_str());
+    }
+    args.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        execv("/proc/self/exe", const_cast<char* const*>(args.data()));
+        _exit(127);
+    }
+    return pid;
+}
+
+struct Phase {
+    const char* name;
+    std::vector<nsecs_t> latencies;
+    SchedInfo server = {};
+    size_t errors = 0;
+
+    nsecs_t percentile(double p) const {
+        if (latencies.empty()) return 0;
+        return latencies[std::min(static_cast<size_t>(p * latencies.size()),
+                                  latencies.size() - 1)];
+    }
+};
+
+static void runPhase(const sp<IBinder>& binder, const Options& opts, Phase* phase) {
+    phase->latencies.reserve(opts.iterations);
+    for (size_t i = 0; i < opts.iterations; i++) {
+        Parcel data, reply;
+        data.writeInt64(opts.work);
+        nsecs_t begin = systemTime(SYSTEM_TIME_MONOTONIC);
+        status_t err = binder->transact(SPIN_TRANSACTION, data, &reply);
+        nsecs_t elapsed = systemTime(SYSTEM_TIME_MONOTONIC) - begin;
+        if (err != NO_ERROR) {
+            phase->errors++;
+            continue;
+        }
+        phase->latencies.push_back(elapsed);
+        phase->server.policy = reply.readInt32();
+        phase->server.priority = reply.readInt32();
+        phase->server.nice = reply.readInt32();
+    }
+    std::sort(phase->latencies.begin(), phase->latencies.end());
+}
+
+// Makes the calling thread the high-priority client for |support|.
+static bool raisePriority(PriorityInheritance::Support support) {
+    if (support == PriorityInheritance::Support::RealTime) {
+        sched_param param = {};
+        param.sched_priority = kRtPriority;
+        return sched_setscheduler(0, SCHED_FIFO, &param) == 0;
+    }
+    return setpriority(PRIO_PROCESS, 0, kNice) == 0;
+}
+
+static bool expectedServer(PriorityInheritance::Support support, const SchedInfo& server) {
+    switch (support) {
+        case PriorityInheritance::Support::RealTime:
+            return server.policy == SCHED_FIFO && server.priority == kRtPriority;
+        case PriorityInheritance::Support::Nice:
+            return server.nice == kNice;
+        case PriorityInheritance::Support::None:
+            return true;
+    }
+    return false;
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option longOptions[] = {
+            {"driver", required_argument, nullptr, 'd'},
+            {"cpu", required_argument, nullptr, 'c'},
+            {"load", required_argument, nullptr, 'l'},
+            {"iterations", required_argument, nullptr, 'n'},
+            {"work", required_argument, nullptr, 'w'},
+            {"max-ratio", required_argument, nullptr, 'r'},
+            {"server", required_argument, nullptr, 'S'},
+            {"help", no_argument, nullptr, 'h'},
+            {nullptr, 0, nullptr, 0},
+    };
+
+    Options opts;
+    std::string serverName;
+    int c;
+    while ((c = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+        switch (c) {
+            case 'd': opts.driver = optarg; break;
+            case 'c': opts.cpu = atoi(optarg); break;
+            case 'l': opts.load = strtoull(optarg, nullptr, 0); break;
+            case 'n': opts.iterations = std::max<size_t>(strtoull(optarg, nullptr, 0), 1); break;
+            case 'w': opts.work = us2ns(strtoll(optarg, nullptr, 0)); break;
+            case 'r': opts.maxRatio = atof(optarg); break;
+            case 'S': serverName = optarg; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (!opts.driver.empty()) {
+        ProcessState::initWithDriver(opts.driver.c_str());
+    }
+    if (!serverName.empty()) {
+        return runServer(serverName);
+    }
+
+    const PriorityInheritance::Support support = PriorityInheritance::support();
+    printf("priority inheritance: %s\n", PriorityInheritance::toString(support));
+
+    // Affinity is inherited by the server and the hogs.
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(opts.cpu, &cpus);
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) != 0) {
+        fprintf(stderr, "%s - Failed to pin to CPU %d\n", strerror(errno), opts.cpu);
+        return 1;
+    }
+
+    ProcessState::self()->setThreadPoolMaxThreadCount(0);
+    const std::string name = "binder.priority." + std::to_string(getpid());
+    pid_t pid = spawnServer(opts, name);
+    if (pid < 0) {
+        fprintf(stderr, "%s - Failed to spawn server\n", strerror(errno));
+        return 1;
+    }
+    sp<IBinder> binder = defaultServiceManager()->waitForService(String16(name.c_str()));
+
+    int result = 1;
+    Phase idle{"idle"}, loaded{"loaded"};
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> hogs;
+    if (binder == nullptr) {
+        fprintf(stderr, "Failed to get service %s\n", name.c_str());
+    } else if (!raisePriority(support)) {
+        printf("SKIP: %s - cannot raise the client's priority\n", strerror(errno));
+        result = 0;
+    } else {
+        runPhase(binder, opts, &idle);
+        for (size_t i = 0; i < opts.load; i++) {
+            hogs.emplace_back([&] {
+                // Hogs must not inherit the client's priority.
+                sched_param param = {};
+                sched_setscheduler(0, SCHED_OTHER, &param);
+                setpriority(PRIO_PROCESS, 0, 0);
+                while (!stop.load(std::memory_order_relaxed)) {
+                }
+            });
+        }
+        runPhase(binder, opts, &loaded);
+        result = 0;
+    }
+    stop = true;
+    for (auto& t : hogs) {
+        t.join();
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+    if (binder == nullptr || idle.latencies.empty()) return result;
+
+    printf("%8s %10s %10s %10s %7s  %s\n", "phase", "p50(us)", "p99(us)", "max(us)", "errors",
+           "server");
+    for (const Phase* phase : {&idle, &loaded}) {
+        printf("%8s %10.1f %10.1f %10.1f %7zu  %s/%d nice %d\n", phase->name,
+               phase->percentile(0.50) / 1e3, phase->percentile(0.99) / 1e3,
+               phase->latencies.empty() ? 0 : phase->latencies.back() / 1e3, phase->errors,
+               policyName(phase->server.policy), phase->server.priority, phase->server.nice);
+    }
+
+    const double ratio = loaded.latencies.empty()
+            ? 0
+            : static_cast<double>(loaded.percentile(0.99)) / idle.percentile(0.99);
+    printf("inversion: loaded p99 is %.2fx idle p99\n", ratio);
+
+    if (idle.errors + loaded.errors > 0) {
+        printf("FAIL: transactions failed\n");
+        return 1;
+    }
+    if (!expectedServer(support, idle.server) || !expectedServer(support, loaded.server)) {
+        printf("FAIL: server did not run with the caller's priority\n");
+        return 1;
+    }
+    if (support != PriorityInheritance::Support::None && ratio > opts.maxRatio) {
+        printf("FAIL: loaded p99 exceeds %.1fx idle p99\n", opts.maxRatio);
+        return 1;
+    }
+    printf("PASS\n");
+    return 0;
+}
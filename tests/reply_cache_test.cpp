@@ -0,0 +1,139 @@
+#define LOG_TAG "ReplyCacheTest"
+
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <vector>
+
+#include <binder/Binder.h>
+#include <binder/Parcel.h>
+#include <binder/ReplyCache.h>
+#include <gtest/gtest.h>
+
+using namespace android;
+
+// ReplyCache without a driver, against a local service: cacheable calls are
+// answered from the cache until the service invalidates it, everything else
+// reaches the service, and clients cannot write to the published generation
+// counter.
+
+enum {
+    GET_TRANSACTION = IBinder::FIRST_CALL_TRANSACTION,
+    ECHO_TRANSACTION,
+};
+
+class Config : public BBinder {
+public:
+    status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply,
+                        uint32_t flags) override {
+        switch (code) {
+            case GET_TRANSACTION:
+                calls++;
+                return reply->writeInt32(value + data.readInt32());
+            case ECHO_TRANSACTION:
+                calls++;
+                if (reply == nullptr) return NO_ERROR;
+                return reply->writeInt32(data.readInt32());
+            default:
+                return BBinder::onTransact(code, data, reply, flags);
+        }
+    }
+
+    std::atomic<int> calls{0};
+    int32_t value = 100;
+};
+
+// Returns the reply value, or -1.
+static int32_t call(ReplyCache* cache, uint32_t code, int32_t arg, uint32_t flags = 0) {
+    Parcel data, reply;
+    data.writeInt32(arg);
+    if (cache->transact(code, data, &reply, flags) != NO_ERROR) return -1;
+    return (flags & IBinder::FLAG_ONEWAY) ? 0 : reply.readInt32();
+}
+
+TEST(ReplyCacheTest, Unpublished) {
+    sp<Config> service = sp<Config>::make();
+    ReplyCache cache(service);
+    EXPECT_EQ(call(&cache, GET_TRANSACTION, 1), 101) << "reply without a cache";
+    call(&cache, GET_TRANSACTION, 1);
+    EXPECT_EQ(service->calls, 2) << "service without cacheable codes not passed through";
+    EXPECT_EQ(cache.stats().hits, 0u) << "hit without cacheable codes";
+}
+
+class ReplyCachePublished : public ::testing::Test {
+protected:
+    void SetUp() override {
+        service = sp<Config>::make();
+        status_t err = ReplyCache::setCacheable(service, {GET_TRANSACTION});
+        if (err == INVALID_OPERATION) {
+            GTEST_SKIP() << "the kernel cannot seal the generation counter";
+        }
+        ASSERT_EQ(err, OK);
+    }
+
+    sp<Config> service;
+};
+
+TEST_F(ReplyCachePublished, Cache) {
+    ReplyCache cache(service);
+    EXPECT_EQ(call(&cache, GET_TRANSACTION, 1), 101) << "first reply";
+    EXPECT_EQ(call(&cache, GET_TRANSACTION, 1), 101) << "cached reply";
+    EXPECT_EQ(service->calls, 1) << "repeated call reached the service";
+    EXPECT_EQ(call(&cache, GET_TRANSACTION, 2), 102) << "reply to another request";
+    EXPECT_EQ(service->calls, 2) << "another request answered from the cache";
+
+    service->value = 200;
+    ReplyCache::invalidate(service);
+    EXPECT_EQ(call(&cache, GET_TRANSACTION, 1), 201) << "stale reply after invalidate()";
+    EXPECT_EQ(call(&cache, GET_TRANSACTION, 1), 201) << "cached reply after invalidate()";
+    EXPECT_EQ(service->calls, 3) << "calls after invalidate()";
+
+    // Not cacheable: another code, and oneway calls.
+    call(&cache, ECHO_TRANSACTION, 1);
+    call(&cache, ECHO_TRANSACTION, 1);
+    call(&cache, GET_TRANSACTION, 1, IBinder::FLAG_ONEWAY);
+    EXPECT_EQ(service->calls, 6) << "uncacheable calls not passed through";
+
+    const ReplyCache::Stats stats = cache.stats();
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.misses, 3u);
+}
+
+// A code the service stops marking cacheable must reach it again.
+TEST_F(ReplyCachePublished, ShrinkCodes) {
+    ASSERT_EQ(ReplyCache::setCacheable(service, {GET_TRANSACTION, ECHO_TRANSACTION}), OK);
+    ReplyCache cache(service);
+    EXPECT_EQ(call(&cache, ECHO_TRANSACTION, 7), 7);
+    EXPECT_EQ(call(&cache, ECHO_TRANSACTION, 7), 7);
+    EXPECT_EQ(service->calls, 1) << "cacheable code not cached";
+
+    ASSERT_EQ(ReplyCache::setCacheable(service, {GET_TRANSACTION}), OK);
+    EXPECT_EQ(call(&cache, ECHO_TRANSACTION, 7), 7);
+    EXPECT_EQ(call(&cache, ECHO_TRANSACTION, 7), 7);
+    EXPECT_EQ(service->calls, 3) << "code dropped by the service still cached";
+    call(&cache, GET_TRANSACTION, 1);
+    call(&cache, GET_TRANSACTION, 1);
+    EXPECT_EQ(service->calls, 4) << "remaining code no longer cached";
+}
+
+// What a client gets to map, straight from QUERY_TRANSACTION.
+TEST_F(ReplyCachePublished, GenerationIsReadOnly) {
+    Parcel data, reply;
+    int32_t version;
+    uint64_t codesVersion;
+    std::vector<int32_t> codes;
+    ASSERT_EQ(service->transact(ReplyCache::QUERY_TRANSACTION, data, &reply), NO_ERROR);
+    ASSERT_EQ(reply.readInt32(&version), NO_ERROR);
+    ASSERT_EQ(reply.readUint64(&codesVersion), NO_ERROR);
+    ASSERT_EQ(reply.readInt32Vector(&codes), NO_ERROR);
+    const int fd = reply.readFileDescriptor();
+    const size_t size = sizeof(uint64_t);
+    void* map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    EXPECT_EQ(map, MAP_FAILED) << "client mapped the generation writable";
+    if (map != MAP_FAILED) munmap(map, size);
+    const uint64_t generation = 0;
+    EXPECT_LT(pwrite(fd, &generation, size, 0), 0) << "client wrote the generation";
+    EXPECT_NE(ftruncate(fd, 0), 0) << "client truncated the generation";
+}
@@ -0,0 +1,106 @@
+#define LOG_TAG "ScatterGatherTest"
+
+#include <string.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include <binder/Parcel.h>
+#include <binder/ParcelObjectIndex.h>
+#include <binder/ScatterGather.h>
+#include <gtest/gtest.h>
+
+using namespace android;
+
+// ScatterGather without a driver: buffers read back from a Parcel handed to a
+// local binder, they are listed with the Parcel's other objects so that
+// copies and resends keep them, and reads are checked against the full size
+// of a buffer object.
+
+TEST(ScatterGatherTest, Local) {
+    std::vector<uint8_t> frame(4096, 0x5a);
+    Parcel data;
+    data.writeInt32(1);
+    ASSERT_EQ(ScatterGather::writeBuffer(&data, frame.data(), frame.size()), NO_ERROR);
+    data.writeInt32(2);
+    EXPECT_TRUE(ScatterGather::hasBuffers(data));
+
+    // Twice, as for a Parcel that is sent again.
+    for (int i = 0; i < 2; i++) {
+        data.setDataPosition(0);
+        const void* buffer = nullptr;
+        size_t size = 0;
+        EXPECT_EQ(data.readInt32(), 1) << "data in front of the buffer";
+        ASSERT_EQ(ScatterGather::readBuffer(data, &buffer, &size), NO_ERROR);
+        EXPECT_EQ(buffer, frame.data());
+        EXPECT_EQ(size, frame.size());
+        EXPECT_EQ(data.readInt32(), 2) << "data behind the buffer";
+    }
+
+    data.freeData();
+    EXPECT_FALSE(ScatterGather::hasBuffers(data)) << "buffers kept across freeData()";
+}
+
+// Bytes that look like a buffer object are not one.
+TEST(ScatterGatherTest, NotAnObject) {
+    std::vector<uint8_t> frame(64);
+    Parcel written;
+    ScatterGather::writeBuffer(&written, frame.data(), frame.size());
+
+    Parcel data;
+    data.write(written.data(), written.dataSize());
+    EXPECT_FALSE(ScatterGather::hasBuffers(data));
+    data.setDataPosition(0);
+    const void* buffer;
+    size_t size;
+    EXPECT_EQ(ScatterGather::readBuffer(data, &buffer, &size), BAD_TYPE);
+    EXPECT_EQ(data.dataPosition(), 0u);
+}
+
+TEST(ScatterGatherTest, BuffersSize) {
+    std::vector<uint8_t> first(13), second(32);
+    Parcel data;
+    EXPECT_EQ(ScatterGather::buffersSize(data), 0u);
+    data.writeDupFileDescriptor(STDOUT_FILENO);
+    const binder_size_t firstOffset = data.dataPosition();
+    ScatterGather::writeBuffer(&data, first.data(), first.size());
+    const binder_size_t fdOffset = data.dataPosition();
+    data.writeDupFileDescriptor(STDOUT_FILENO);
+    const binder_size_t secondOffset = data.dataPosition();
+    ScatterGather::writeBuffer(&data, second.data(), second.size());
+
+    // The offsets writeTransactionData() passes to the driver.
+    const binder_size_t expected[] = {0, firstOffset, fdOffset, secondOffset};
+    ASSERT_EQ(data.ipcObjectsCount(), 4u);
+    EXPECT_EQ(memcmp(data.ipcObjects(), expected, sizeof(expected)), 0)
+            << "buffer objects not listed in order";
+    EXPECT_EQ(ScatterGather::buffersSize(data), 16u + 32u) << "not rounded up per buffer";
+
+    // A copy carries the same buffers.
+    Parcel copy;
+    ASSERT_EQ(copy.appendFrom(&data, 0, data.dataSize()), NO_ERROR);
+    EXPECT_EQ(ScatterGather::buffersSize(copy), 16u + 32u);
+}
+
+// A buffer object is 40 bytes, a flat_binder_object 24: reads between the
+// two would hand out the buffer pointer the driver wrote.
+TEST(ScatterGatherTest, ObjectSize) {
+    uint64_t data[16] = {};
+    binder_buffer_object buffer = {};
+    buffer.hdr.type = BINDER_TYPE_PTR;
+    memcpy(data, &buffer, sizeof(buffer));
+    flat_binder_object flat = {};
+    flat.hdr.type = BINDER_TYPE_FD;
+    memcpy(reinterpret_cast<uint8_t*>(data) + sizeof(buffer), &flat, sizeof(flat));
+
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+    const binder_size_t objects[] = {0, sizeof(buffer)};
+    EXPECT_EQ(ParcelObjectIndex::objectSize(bytes, 0), sizeof(binder_buffer_object));
+    EXPECT_EQ(ParcelObjectIndex::objectSize(bytes, sizeof(buffer)), sizeof(flat_binder_object));
+    EXPECT_EQ(ParcelObjectIndex::seek(bytes, objects, 2, sizeof(flat_binder_object)), 0u)
+            << "position inside a buffer object skipped it";
+    EXPECT_EQ(ParcelObjectIndex::seek(bytes, objects, 2, sizeof(buffer)), 1u)
+            << "position behind a buffer object";
+    EXPECT_EQ(ParcelObjectIndex::seek(bytes, objects, 2, sizeof(buffer) + sizeof(flat)), 2u)
+            << "position behind all objects";
+}
@@ -0,0 +1,237 @@
+#define LOG_TAG "ThreadPoolTest"
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <binder/Binder.h>
+#include <binder/IPCThreadState.h>
+#include <binder/IServiceManager.h>
+#include <binder/Parcel.h>
+#include <binder/ProcessState.h>
+#include <binder/ThreadPoolPolicy.h>
+
+using namespace android;
+
+// binder_thread_pool_test checks that an elastic thread pool shrinks back
+// and stays small. A burst of slow calls grows the server's pool; a steady
+// light load behind it must then let the idle threads go, and must not
+// make the driver ask for new ones: idle threads wait in the driver, so it
+// always finds one waiting.
+
+enum {
+    SLOW_TRANSACTION = IBinder::FIRST_CALL_TRANSACTION,
+    LIGHT_TRANSACTION,
+    STATS_TRANSACTION,
+};
+
+constexpr size_t kMinThreads = 1;
+constexpr size_t kMaxThreads = 8;
+constexpr nsecs_t kIdleTimeout = 200 * 1000000ll;
+constexpr useconds_t kSlowCall = 100 * 1000;
+constexpr useconds_t kLightInterval = 20 * 1000;
+
+struct Options {
+    std::string driver;
+    // Length of the light load, in calls.
+    size_t calls = 100;
+};
+
+class Server : public BBinder {
+    status_t onTransact(uint32_t code, const Parcel& data, Parcel* reply,
+                        uint32_t flags) override {
+        switch (code) {
+            case SLOW_TRANSACTION:
+                usleep(kSlowCall);
+                return NO_ERROR;
+            case LIGHT_TRANSACTION:
+                return NO_ERROR;
+            case STATS_TRANSACTION: {
+                const ThreadPoolPolicy::Stats stats = ThreadPoolPolicy::stats();
+                reply->writeUint64(stats.threads);
+                reply->writeUint64(stats.spawned);
+                return reply->writeUint64(stats.reaped);
+            }
+            default:
+                return BBinder::onTransact(code, data, reply, flags);
+        }
+    }
+};
+
+static void usage(const char* prog) {
+    printf("Usage: %s [options]\n"
+           "\n"
+           "  --driver PATH       binder device (default: /dev/binder)\n"
+           "  --calls N           calls of the light load (default: 100)\n",
+           prog);
+}
+
+static int runServer(const std::string& name) {
+    ThreadPoolPolicy::Policy policy;
+    policy.minThreads = kMinThreads;
+    policy.maxThreads = kMaxThreads;
+    policy.idleTimeout = kIdleTimeout;
+    if (ThreadPoolPolicy::setPolicy(policy) != NO_ERROR) {
+        fprintf(stderr, "Failed to set the thread pool policy\n");
+        return 1;
+    }
+    if (defaultServiceManager()->addService(String16(name.c_str()), sp<Server>::make()) !=
+        NO_ERROR) {
+        fprintf(stderr, "Failed addService(%s)\n", name.c_str());
+        return 1;
+    }
+    ProcessState::self()->startThreadPool();
+    IPCThreadState::self()->joinThreadPool();
+    return 0;
+}
+
+static pid_t spawnServer(const Options& opts, const std::string& name) {
+    std::vector<const char*> args = {"binder_thread_pool_test", "--server", name.c_str()};
+    if (!opts.driver.empty()) {
+        args.push_back("--driver");
+        args.push_back(opts.driver.c_str());
+    }
+    args.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        execv("/proc/self/exe", const_cast<char* const*>(args.data()));
+        _exit(127);
+    }
+    return pid;
+}
+
+// Like waitForService(), but gives up when the server exits.
+static sp<IBinder> waitForServer(pid_t pid, const std::string& name) {
+    while (true) {
+        sp<IBinder> binder = defaultServiceManager()->checkService(String16(name.c_str()));
+        if (binder != nullptr) return binder;
+        if (waitpid(pid, nullptr, WNOHANG) != 0) return nullptr;
+        usleep(10000);
+    }
+}
+
+static bool call(const sp<IBinder>& binder, uint32_t code) {
+    Parcel data, reply;
+    return binder->transact(code, data, &reply) == NO_ERROR;
+}
+
+static bool stats(const sp<IBinder>& binder, ThreadPoolPolicy::Stats* stats) {
+    Parcel data, reply;
+    uint64_t threads, spawned, reaped;
+    if (binder->transact(STATS_TRANSACTION, data, &reply) != NO_ERROR ||
+        reply.readUint64(&threads) != NO_ERROR || reply.readUint64(&spawned) != NO_ERROR ||
+        reply.readUint64(&reaped) != NO_ERROR) {
+        return false;
+    }
+    stats->threads = threads;
+    stats->spawned = spawned;
+    stats->reaped = reaped;
+    return true;
+}
+
+static void print(const char* phase, const ThreadPoolPolicy::Stats& stats) {
+    printf("%s: %zu spawned threads, %zu spawned, %zu reaped\n", phase, stats.threads,
+           stats.spawned, stats.reaped);
+}
+
+static bool run(const sp<IBinder>& server, const Options& opts) {
+    ThreadPoolPolicy::Stats burst, settled, light;
+
+    std::vector<std::thread> callers;
+    for (size_t i = 0; i < kMaxThreads; i++) {
+        callers.emplace_back([&server] { call(server, SLOW_TRANSACTION); });
+    }
+    for (std::thread& caller : callers) caller.join();
+    if (!stats(server, &burst)) return false;
+    print("burst", burst);
+    if (burst.threads <= kMinThreads + 1) {
+        printf("FAIL: the burst did not grow the pool\n");
+        return false;
+    }
+
+    // The first calls of the light load give the idle threads time to go.
+    const size_t settle = ns2us(kIdleTimeout) * 2 / kLightInterval;
+    for (size_t i = 0; i < settle + opts.calls; i++) {
+        if (i == settle && !stats(server, &settled)) return false;
+        if (!call(server, LIGHT_TRANSACTION)) {
+            printf("FAIL: light call failed\n");
+            return false;
+        }
+        usleep(kLightInterval);
+    }
+    if (!stats(server, &light)) return false;
+    print("settled", settled);
+    print("light", light);
+
+    bool ok = true;
+    if (light.threads > kMinThreads + 1) {
+        printf("FAIL: the pool did not shrink under a light load\n");
+        ok = false;
+    }
+    if (light.spawned > settled.spawned + 1) {
+        printf("FAIL: the light load kept spawning threads\n");
+        ok = false;
+    }
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option longOptions[] = {
+            {"driver", required_argument, nullptr, 'd'},
+            {"calls", required_argument, nullptr, 'n'},
+            {"server", required_argument, nullptr, 'S'},
+            {"help", no_argument, nullptr, 'h'},
+            {nullptr, 0, nullptr, 0},
+    };
+
+    Options opts;
+    std::string serverName;
+    int c;
+    while ((c = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+        switch (c) {
+            case 'd': opts.driver = optarg; break;
+            case 'n': opts.calls = strtoull(optarg, nullptr, 0); break;
+            case 'S': serverName = optarg; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (!opts.driver.empty()) {
+        ProcessState::initWithDriver(opts.driver.c_str());
+    }
+    if (!serverName.empty()) {
+        return runServer(serverName);
+    }
+
+    ProcessState::self()->setThreadPoolMaxThreadCount(0);
+    const std::string name = "binder.pool." + std::to_string(getpid());
+    pid_t pid = spawnServer(opts, name);
+    if (pid < 0) {
+        fprintf(stderr, "%s - Failed to spawn the server\n", strerror(errno));
+        return 1;
+    }
+    sp<IBinder> server = waitForServer(pid, name);
+
+    int result = 1;
+    if (server == nullptr) {
+        fprintf(stderr, "Failed to get the service\n");
+    } else if (run(server, opts)) {
+        printf("PASS\n");
+        result = 0;
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, nullptr, 0);
+    return result;
+}
@@ -0,0 +1,92 @@
+#define LOG_TAG "Utf8TranscoderTest"
+
+#include <random>
+#include <vector>
+
+#include <binder/Utf8Transcoder.h>
+#include <gtest/gtest.h>
+#include <utils/Unicode.h>
+
+using namespace android;
+
+// Utf8Transcoder must match the libutils functions it replaces on random
+// strings: mostly ASCII so that the vectorized runs are taken, with
+// multi-byte sequences, surrogates and malformed bytes mixed in at random
+// positions, and destinations that are sometimes too short.
+
+constexpr size_t kIterations = 200000;
+// Longer than a few 32-character blocks, so runs start and end anywhere.
+constexpr size_t kMaxLength = 300;
+// Canary around the destinations.
+constexpr size_t kSlack = 4;
+
+static std::mt19937 gRandom(1);
+
+static size_t random(size_t bound) {
+    return gRandom() % bound;
+}
+
+// Mostly ASCII in runs, then anything, including bytes that cannot start or
+// continue a sequence.
+static std::vector<uint8_t> randomUtf8() {
+    std::vector<uint8_t> bytes(random(kMaxLength));
+    const bool asciiRun = random(2) == 0;
+    for (uint8_t& b : bytes) {
+        b = (asciiRun ? random(64) != 0 : random(10) < 7) ? random(0x80) : random(0x100);
+    }
+    return bytes;
+}
+
+// Mostly ASCII, then BMP characters and lone or paired surrogates.
+static std::vector<char16_t> randomUtf16() {
+    std::vector<char16_t> units(random(kMaxLength));
+    const bool asciiRun = random(2) == 0;
+    for (char16_t& u : units) {
+        const size_t kind = asciiRun && random(64) != 0 ? 0 : random(10);
+        u = kind < 6 ? random(0x80) : kind < 8 ? random(0x10000) : 0xd800 + random(0x800);
+    }
+    return units;
+}
+
+static ::testing::AssertionResult checkUtf8ToUtf16(const std::vector<uint8_t>& src) {
+    const ssize_t length = Utf8Transcoder::utf8ToUtf16Length(src.data(), src.size());
+    if (length != utf8_to_utf16_length(src.data(), src.size())) {
+        return ::testing::AssertionFailure() << "utf8ToUtf16Length() of " << src.size() << " bytes";
+    }
+    if (length < 0) return ::testing::AssertionSuccess();
+
+    // The full length, or a destination that cuts the string short.
+    const size_t dstLen = random(3) != 0 ? length + 1 : random(length + 1) + 1;
+    std::vector<char16_t> actual(dstLen + kSlack, 0x7777), expected(dstLen + kSlack, 0x7777);
+    const char16_t* actualEnd =
+            Utf8Transcoder::utf8ToUtf16(src.data(), src.size(), actual.data(), dstLen);
+    const char16_t* expectedEnd = utf8_to_utf16(src.data(), src.size(), expected.data(), dstLen);
+    if (actualEnd - actual.data() != expectedEnd - expected.data() || actual != expected) {
+        return ::testing::AssertionFailure()
+                << "utf8ToUtf16() of " << src.size() << " bytes into " << dstLen << " units";
+    }
+    return ::testing::AssertionSuccess();
+}
+
+static ::testing::AssertionResult checkUtf16ToUtf8(const std::vector<char16_t>& src) {
+    const ssize_t length = Utf8Transcoder::utf16ToUtf8Length(src.data(), src.size());
+    if (length != utf16_to_utf8_length(src.data(), src.size())) {
+        return ::testing::AssertionFailure() << "utf16ToUtf8Length() of " << src.size() << " units";
+    }
+    if (length < 0) return ::testing::AssertionSuccess();
+
+    std::vector<char> actual(length + 1 + kSlack, 'Z'), expected(length + 1 + kSlack, 'Z');
+    Utf8Transcoder::utf16ToUtf8(src.data(), src.size(), actual.data(), length + 1);
+    utf16_to_utf8(src.data(), src.size(), expected.data(), length + 1);
+    if (actual != expected) {
+        return ::testing::AssertionFailure() << "utf16ToUtf8() of " << src.size() << " units";
+    }
+    return ::testing::AssertionSuccess();
+}
+
+TEST(Utf8TranscoderTest, MatchesLibutils) {
+    for (size_t i = 0; i < kIterations && !HasFailure(); i++) {
+        EXPECT_TRUE(checkUtf8ToUtf16(randomUtf8()));
+        EXPECT_TRUE(checkUtf16ToUtf8(randomUtf16()));
+    }
+}
@@ -0,0 +1,264 @@
+#define LOG_TAG "BinderFreezer"
+
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <binder/IBinder.h>
+#include <binder/IServiceManager.h>
+#include <binder/ProcessFreezer.h>
+#include <binder/ProcessState.h>
+#include <utils/String16.h>
+#include <utils/Timers.h>
+
+using namespace android;
+
+// binder_freezer freezes service processes that have not received a
+// transaction for a while and thaws them as soon as someone calls them.
+//
+// Activity is read from the binderfs stats log. A frozen process rejects
+// synchronous calls with BR_FROZEN_REPLY (FAILED_TRANSACTION in the caller,
+// see ProcessFreezer::lastCallHitFrozen()); the supervisor sees that through
+// BINDER_GET_FROZEN_INFO, thaws the process and reports the callers that
+// were turned away, which may retry. Oneway calls are only queued and are
+// delivered on thaw.
+
+struct Options {
+    std::string driver;
+    std::string logs = "/dev/binderfs/binder_logs";
+    nsecs_t idle = s2ns(30);
+    nsecs_t interval = ms2ns(100);
+    nsecs_t drain = ms2ns(100);
+    bool stop = false;
+};
+
+struct Counters {
+    long incoming = 0;
+    long frozenReplies = 0;
+};
+
+struct Managed {
+    Managed(pid_t pid, std::string name) : pid(pid), name(std::move(name)) {}
+
+    pid_t pid;
+    std::string name;
+    long incoming = -1;
+    nsecs_t lastActive = 0;
+    bool frozen = false;
+    nsecs_t frozenAt = 0;
+    // BR_FROZEN_REPLY counts of every process when this one was frozen.
+    std::map<pid_t, long> frozenReplies;
+};
+
+static volatile sig_atomic_t gExit = 0;
+
+static void onSignal(int) {
+    gExit = 1;
+}
+
+static void usage(const char* prog) {
+    printf("Usage: %s [options] (pid | --service NAME)...\n"
+           "\n"
+           "  --driver PATH       binder device (default: /dev/binder)\n"
+           "  --logs DIR          binderfs log directory (default: /dev/binderfs/binder_logs)\n"
+           "  --service NAME      manage the process hosting service NAME\n"
+           "  --idle SEC          freeze after SEC seconds without calls (default: 30)\n"
+           "  --interval MS       polling interval (default: 100)\n"
+           "  --drain MS          wait for calls in flight before freezing (default: 100)\n"
+           "  --stop              also SIGSTOP frozen processes\n"
+           "\nExample)\n$ %s --idle 10 --service test.Echo 1234\n",
+           prog, prog);
+}
+
+// Per-pid counters from the stats log, summed over contexts.
+static bool readCounters(const std::string& dir, std::map<pid_t, Counters>* out) {
+    std::ifstream in(dir + "/stats");
+    if (!in) {
+        fprintf(stderr, "%s - Failed to open %s/stats\n", strerror(errno), dir.c_str());
+        return false;
+    }
+    out->clear();
+    Counters* current = nullptr;
+    std::string line;
+    while (std::getline(in, line)) {
+        int pid;
+        char name[64];
+        long value;
+        if (sscanf(line.c_str(), "proc %d", &pid) == 1) {
+            current = &(*out)[pid];
+            continue;
+        }
+        if (current == nullptr || sscanf(line.c_str(), "  %63[A-Z_]: %ld", name, &value) != 2) {
+            continue;
+        }
+        if (!strcmp(name, "BR_TRANSACTION") || !strcmp(name, "BR_TRANSACTION_SEC_CTX")) {
+            current->incoming += value;
+        } else if (!strcmp(name, "BR_FROZEN_REPLY")) {
+            current->frozenReplies += value;
+        }
+    }
+    return true;
+}
+
+static std::string commandName(pid_t pid) {
+    std::ifstream in("/proc/" + std::to_string(pid) + "/comm");
+    std::string name;
+    std::getline(in, name);
+    return name.empty() ? "?" : name;
+}
+
+static bool freeze(Managed* m, const Options& opts, const std::map<pid_t, Counters>& counters) {
+    status_t err = ProcessFreezer::freeze(m->pid, opts.drain);
+    if (err == -EAGAIN) return false;  // busy, try again later
+    if (err != NO_ERROR) {
+        fprintf(stderr, "%s - Failed to freeze %d (%s)\n", strerror(-err), m->pid,
+                m->name.c_str());
+        return false;
+    }
+    if (opts.stop) kill(m->pid, SIGSTOP);
+    m->frozen = true;
+    m->frozenAt = systemTime(SYSTEM_TIME_MONOTONIC);
+    m->frozenReplies.clear();
+    for (const auto& [pid, c] : counters) {
+        m->frozenReplies[pid] = c.frozenReplies;
+    }
+    printf("froze %d (%s)\n", m->pid, m->name.c_str());
+    return true;
+}
+
+static void thaw(Managed* m, const Options& opts, const char* reason) {
+    if (opts.stop) kill(m->pid, SIGCONT);
+    status_t err = ProcessFreezer::thaw(m->pid);
+    if (err != NO_ERROR) {
+        fprintf(stderr, "%s - Failed to thaw %d (%s)\n", strerror(-err), m->pid,
+                m->name.c_str());
+    }
+    m->frozen = false;
+    m->lastActive = systemTime(SYSTEM_TIME_MONOTONIC);
+    printf("thawed %d (%s) after %.1fs: %s\n", m->pid, m->name.c_str(),
+           (m->lastActive - m->frozenAt) / 1e9, reason);
+}
+
+// Lists the callers that got BR_FROZEN_REPLY while |m| was frozen. Other
+// processes frozen at the same time are counted too; the log does not say
+// which target a reply came from.
+static void reportRejected(const Managed& m, const std::map<pid_t, Counters>& counters) {
+    for (const auto& [pid, c] : counters) {
+        auto it = m.frozenReplies.find(pid);
+        long before = it != m.frozenReplies.end() ? it->second : 0;
+        if (c.frozenReplies > before) {
+            printf("  %d (%s) got BR_FROZEN_REPLY %ld time(s)\n", pid, commandName(pid).c_str(),
+                   c.frozenReplies - before);
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option longOptions[] = {
+            {"driver", required_argument, nullptr, 'd'},
+            {"logs", required_argument, nullptr, 'l'},
+            {"service", required_argument, nullptr, 's'},
+            {"idle", required_argument, nullptr, 'i'},
+            {"interval", required_argument, nullptr, 'w'},
+            {"drain", required_argument, nullptr, 't'},
+            {"stop", no_argument, nullptr, 'S'},
+            {"help", no_argument, nullptr, 'h'},
+            {nullptr, 0, nullptr, 0},
+    };
+
+    Options opts;
+    std::vector<std::string> services;
+    int c;
+    while ((c = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+        switch (c) {
+            case 'd': opts.driver = optarg; break;
+            case 'l': opts.logs = optarg; break;
+            case 's': services.push_back(optarg); break;
+            case 'i': opts.idle = s2ns(strtoll(optarg, nullptr, 0)); break;
+            case 'w': opts.interval = ms2ns(std::max(strtoll(optarg, nullptr, 0), 1ll)); break;
+            case 't': opts.drain = ms2ns(strtoll(optarg, nullptr, 0)); break;
+            case 'S': opts.stop = true; break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind >= argc && services.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (!opts.driver.empty()) {
+        ProcessState::initWithDriver(opts.driver.c_str());
+    }
+    ProcessState::self()->setThreadPoolMaxThreadCount(0);
+
+    std::vector<Managed> managed;
+    for (int i = optind; i < argc; i++) {
+        pid_t pid = atoi(argv[i]);
+        managed.emplace_back(pid, commandName(pid));
+    }
+    for (const auto& name : services) {
+        sp<IBinder> binder = defaultServiceManager()->checkService(String16(name.c_str()));
+        pid_t pid = 0;
+        if (binder == nullptr || binder->getDebugPid(&pid) != NO_ERROR || pid <= 0) {
+            fprintf(stderr, "Failed to find the process of %s\n", name.c_str());
+            return 1;
+        }
+        managed.emplace_back(pid, name);
+    }
+
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+
+    std::map<pid_t, Counters> counters;
+    while (!gExit) {
+        if (!readCounters(opts.logs, &counters)) break;
+        const nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+        for (auto& m : managed) {
+            auto it = counters.find(m.pid);
+            if (it == counters.end()) {
+                // Exited, or closed the device.
+                m.frozen = false;
+                continue;
+            }
+
+            if (m.frozen) {
+                ProcessFreezer::FrozenInfo info;
+                if (ProcessFreezer::getFrozenInfo(m.pid, &info) != NO_ERROR) continue;
+                if (info.syncReceived) {
+                    thaw(&m, opts, "synchronous call rejected");
+                    reportRejected(m, counters);
+                } else if (info.asyncReceived) {
+                    thaw(&m, opts, "oneway calls queued");
+                }
+                m.incoming = it->second.incoming;
+                continue;
+            }
+
+            if (it->second.incoming != m.incoming) {
+                m.incoming = it->second.incoming;
+                m.lastActive = now;
+            } else if (now - m.lastActive >= opts.idle) {
+                freeze(&m, opts, counters);
+            }
+        }
+        usleep(ns2us(opts.interval));
+    }
+
+    for (auto& m : managed) {
+        if (m.frozen) thaw(&m, opts, "supervisor exiting");
+    }
+    return 0;
+}
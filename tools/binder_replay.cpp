@@ -0,0 +1,222 @@
+#define LOG_TAG "BinderReplay"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <android-base/unique_fd.h>
+#include <binder/IBinder.h>
+#include <binder/IServiceManager.h>
+#include <binder/Parcel.h>
+#include <binder/ProcessState.h>
+#include <binder/RecordedTransaction.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+
+using namespace android;
+using android::base::unique_fd;
+using android::binder::debug::RecordedTransaction;
+
+// binder_replay fires transactions captured by TransactionRecorder (or
+// BINDER_RECORD=<path>) at a live service, either keeping the recorded
+// inter-arrival times or as fast as possible, spread over N threads.
+
+struct Options {
+    std::string driver;
+    std::string service;
+    size_t threads = 1;
+    size_t loops = 1;
+    bool fast = false;
+    double speed = 1.0;
+};
+
+struct ThreadResult {
+    std::vector<nsecs_t> latencies;
+    uint64_t errors = 0;
+    uint64_t mismatches = 0;
+};
+
+static void usage(const char* prog) {
+    printf("Usage: %s --service NAME [options] recording...\n"
+           "\n"
+           "  --driver PATH       binder device (default: /dev/binder)\n"
+           "  --service NAME      service to send the transactions to\n"
+           "  --threads N         sender threads (default: 1)\n"
+           "  --loops N           replay the recordings N times (default: 1)\n"
+           "  --fast              ignore recorded timing, send back to back\n"
+           "  --speed X           scale recorded timing, 2 = twice as fast (default: 1)\n"
+           "\nExample)\n$ %s --service test.Echo --threads 8 --fast /tmp/echo.rec\n",
+           prog, prog);
+}
+
+static bool loadRecording(const char* path, std::vector<RecordedTransaction>* out) {
+    unique_fd fd(TEMP_FAILURE_RETRY(open(path, O_RDONLY | O_CLOEXEC)));
+    if (!fd.ok()) {
+        fprintf(stderr, "%s - Failed to open %s\n", strerror(errno), path);
+        return false;
+    }
+    while (auto transaction = RecordedTransaction::fromFile(fd)) {
+        out->push_back(std::move(*transaction));
+    }
+    return true;
+}
+
+static nsecs_t toNs(const timespec& ts) {
+    return static_cast<nsecs_t>(ts.tv_sec) * 1000000000ll + ts.tv_nsec;
+}
+
+int main(int argc, char* argv[]) {
+    static const struct option longOptions[] = {
+            {"driver", required_argument, nullptr, 'd'},
+            {"service", required_argument, nullptr, 's'},
+            {"threads", required_argument, nullptr, 't'},
+            {"loops", required_argument, nullptr, 'l'},
+            {"fast", no_argument, nullptr, 'f'},
+            {"speed", required_argument, nullptr, 'x'},
+            {"help", no_argument, nullptr, 'h'},
+            {nullptr, 0, nullptr, 0},
+    };
+
+    Options opts;
+    int c;
+    while ((c = getopt_long(argc, argv, "h", longOptions, nullptr)) != -1) {
+        switch (c) {
+            case 'd': opts.driver = optarg; break;
+            case 's': opts.service = optarg; break;
+            case 't': opts.threads = std::max<size_t>(strtoull(optarg, nullptr, 0), 1); break;
+            case 'l': opts.loops = std::max<size_t>(strtoull(optarg, nullptr, 0), 1); break;
+            case 'f': opts.fast = true; break;
+            case 'x': opts.speed = atof(optarg); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (opts.service.empty() || optind >= argc || opts.speed <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    std::vector<RecordedTransaction> transactions;
+    for (int i = optind; i < argc; i++) {
+        if (!loadRecording(argv[i], &transactions)) return 1;
+    }
+    if (transactions.empty()) {
+        fprintf(stderr, "No transactions recorded\n");
+        return 1;
+    }
+
+    if (!opts.driver.empty()) {
+        ProcessState::initWithDriver(opts.driver.c_str());
+    }
+    ProcessState::self()->setThreadPoolMaxThreadCount(0);
+
+    sp<IBinder> binder = defaultServiceManager()->waitForService(String16(opts.service.c_str()));
+    if (binder == nullptr) {
+        fprintf(stderr, "Failed to get service %s\n", opts.service.c_str());
+        return 1;
+    }
+
+    // Transactions recorded on another interface would only produce errors.
+    std::string descriptor = String8(binder->getInterfaceDescriptor()).c_str();
+    size_t skipped = 0;
+    std::vector<const RecordedTransaction*> selected;
+    for (const RecordedTransaction& t : transactions) {
+        if (!t.getInterfaceName().empty() && t.getInterfaceName() != descriptor) {
+            skipped++;
+            continue;
+        }
+        selected.push_back(&t);
+    }
+    if (skipped > 0) {
+        printf("Skipped %zu transactions not recorded on %s\n", skipped, descriptor.c_str());
+    }
+    if (selected.empty()) return 1;
+    // Recordings of several processes interleave.
+    std::stable_sort(selected.begin(), selected.end(),
+                     [](const RecordedTransaction* a, const RecordedTransaction* b) {
+                         return toNs(a->getTimestamp()) < toNs(b->getTimestamp());
+                     });
+
+    const nsecs_t recordedStart = toNs(selected.front()->getTimestamp());
+    const nsecs_t recordedSpan = toNs(selected.back()->getTimestamp()) - recordedStart;
+    std::vector<ThreadResult> results(opts.threads);
+    const nsecs_t start = systemTime(SYSTEM_TIME_MONOTONIC);
+
+    // Thread i sends transactions i, i + threads, ... so that together they
+    // keep the recorded order and timing.
+    auto sender = [&](size_t index) {
+        ThreadResult& result = results[index];
+        result.latencies.reserve(selected.size() * opts.loops / opts.threads + 1);
+        for (size_t loop = 0; loop < opts.loops; loop++) {
+            const nsecs_t loopOffset = loop * (recordedSpan + 1);
+            for (size_t i = index; i < selected.size(); i += opts.threads) {
+                const RecordedTransaction& t = *selected[i];
+                if (!opts.fast) {
+                    nsecs_t due = start +
+                            static_cast<nsecs_t>((toNs(t.getTimestamp()) - recordedStart +
+                                                  loopOffset) / opts.speed);
+                    nsecs_t now = systemTime(SYSTEM_TIME_MONOTONIC);
+                    if (due > now) {
+                        timespec ts = {static_cast<time_t>((due - now) / 1000000000ll),
+                                       static_cast<long>((due - now) % 1000000000ll)};
+                        nanosleep(&ts, nullptr);
+                    }
+                }
+
+                Parcel reply;
+                nsecs_t begin = systemTime(SYSTEM_TIME_MONOTONIC);
+                status_t err = binder->transact(t.getCode(), t.getDataParcel(), &reply,
+                                                t.getFlags() & IBinder::FLAG_ONEWAY);
+                result.latencies.push_back(systemTime(SYSTEM_TIME_MONOTONIC) - begin);
+                if (err != NO_ERROR) {
+                    result.errors++;
+                } else if (t.getReturnedStatus() != NO_ERROR) {
+                    result.mismatches++;
+                }
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < opts.threads; i++) {
+        workers.emplace_back(sender, i);
+    }
+    for (auto& t : workers) {
+        t.join();
+    }
+    const double seconds = (systemTime(SYSTEM_TIME_MONOTONIC) - start) / 1e9;
+
+    std::vector<nsecs_t> all;
+    uint64_t errors = 0, mismatches = 0;
+    for (const ThreadResult& r : results) {
+        all.insert(all.end(), r.latencies.begin(), r.latencies.end());
+        errors += r.errors;
+        mismatches += r.mismatches;
+    }
+    std::sort(all.begin(), all.end());
+    auto percentile = [&](double p) {
+        return all[std::min(static_cast<size_t>(p * all.size()), all.size() - 1)] / 1e3;
+    };
+
+    printf("transactions  %zu\n", all.size());
+    printf("errors        %" PRIu64 "\n", errors);
+    printf("mismatches    %" PRIu64 " (succeeded now, failed when recorded)\n", mismatches);
+    printf("seconds       %.3f\n", seconds);
+    printf("calls/sec     %.0f\n", seconds > 0 ? all.size() / seconds : 0);
+    printf("latency (us)  p50 %.1f  p99 %.1f  p999 %.1f  max %.1f\n", percentile(0.50),
+           percentile(0.99), percentile(0.999), all.back() / 1e3);
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,574 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/android/binder.h>
+
+/*
+ * binder_stat summarizes the binderfs debug logs:
+ *
+ *   stats                   per process thread, buffer and command counters
+ *   state                   every node with its owner, references and queue
+ *   transactions            transactions currently in flight
+ *   failed_transaction_log  the last failed transactions
+ *
+ * With -w the files are sampled periodically and counters are shown as
+ * deltas, which makes a backed up process stand out quickly.
+ */
+
+#define DEFAULT_LOG_DIR "/dev/binderfs/binder_logs"
+#define MAX_NAME 64
+
+struct proc_stat {
+    int pid;
+    char context[MAX_NAME];
+    int threads;
+    int requested;
+    int requested_started;
+    int max_threads;
+    int ready_threads;
+    long free_async_space;
+    int nodes;
+    int refs;
+    int buffers;
+    int pages_active;
+    int pending;
+    /* from the transactions log */
+    int outgoing;
+    int incoming;
+    int async_pending;
+    /* counters, cumulative since the process opened the device */
+    long bc_transaction;
+    long bc_reply;
+    long br_transaction;
+    long br_failed_reply;
+    long br_dead_reply;
+    long br_frozen_reply;
+    long br_oneway_spam;
+};
+
+struct node_stat {
+    int id;
+    int owner;
+    char context[MAX_NAME];
+    int ref_procs;
+    int tmp_refs;
+    int async_pending;
+};
+
+struct talker {
+    int from;
+    int to;
+    int count;
+};
+
+struct failure {
+    int debug_id;
+    char type[8];
+    int from;
+    int to;
+    int ret;
+    int param;
+    int line;
+};
+
+struct snapshot {
+    struct proc_stat *procs;
+    int nprocs;
+    struct node_stat *nodes;
+    int nnodes;
+    struct talker *talkers;
+    int ntalkers;
+    struct failure *failures;
+    int nfailures;
+};
+
+static void *grow(void *array, int count, size_t size)
+{
+    /* Grows in powers of two; called before appending element |count|. */
+    if (count == 0 || (count & (count - 1)) == 0) {
+        array = realloc(array, (count ? count * 2 : 16) * size);
+        if (array == NULL) {
+            printf("Out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    return array;
+}
+
+static char *read_file(const char *dir, const char *name)
+{
+    char path[4096];
+    char *buf = NULL;
+    size_t len = 0, cap = 0;
+    int fd;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("%s - Failed to open %s\n", strerror(errno), path);
+        return NULL;
+    }
+
+    /* seq_file sizes are not known up front. */
+    for (;;) {
+        ssize_t n;
+        if (cap - len < 4096) {
+            cap = cap ? cap * 2 : 65536;
+            buf = realloc(buf, cap + 1);
+            if (buf == NULL) {
+                printf("Out of memory\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        n = read(fd, buf + len, cap - len);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+        len += n;
+    }
+    close(fd);
+    buf[len] = '\0';
+    return buf;
+}
+
+static struct proc_stat *find_proc(struct snapshot *s, int pid, const char *context)
+{
+    int i;
+
+    for (i = 0; i < s->nprocs; i++) {
+        if (s->procs[i].pid == pid && !strcmp(s->procs[i].context, context))
+            return &s->procs[i];
+    }
+    s->procs = grow(s->procs, s->nprocs, sizeof(*s->procs));
+    memset(&s->procs[s->nprocs], 0, sizeof(*s->procs));
+    s->procs[s->nprocs].pid = pid;
+    snprintf(s->procs[s->nprocs].context, MAX_NAME, "%s", context);
+    return &s->procs[s->nprocs++];
+}
+
+static void add_talker(struct snapshot *s, int from, int to)
+{
+    int i;
+
+    for (i = 0; i < s->ntalkers; i++) {
+        if (s->talkers[i].from == from && s->talkers[i].to == to) {
+            s->talkers[i].count++;
+            return;
+        }
+    }
+    s->talkers = grow(s->talkers, s->ntalkers, sizeof(*s->talkers));
+    s->talkers[s->ntalkers].from = from;
+    s->talkers[s->ntalkers].to = to;
+    s->talkers[s->ntalkers].count = 1;
+    s->ntalkers++;
+}
+
+/*
+ * Walks |buf| line by line, tracking the "proc N" / "context X" headers the
+ * kernel prints before every process section.
+ */
+#define for_each_line(line, save, buf) \
+    for (line = strtok_r(buf, "\n", &save); line; line = strtok_r(NULL, "\n", &save))
+
+static void parse_stats(struct snapshot *s, char *buf)
+{
+    char *line, *save;
+    int pid = -1;
+    struct proc_stat *p = NULL;
+    char name[MAX_NAME];
+    long value;
+
+    for_each_line(line, save, buf) {
+        if (sscanf(line, "proc %d", &pid) == 1) {
+            p = NULL;
+            continue;
+        }
+        if (pid >= 0 && sscanf(line, "context %63s", name) == 1) {
+            p = find_proc(s, pid, name);
+            continue;
+        }
+        if (p == NULL)
+            continue;
+
+        if (sscanf(line, "  threads: %d", &p->threads) == 1 ||
+            sscanf(line, "  requested threads: %d+%d/%d", &p->requested,
+                   &p->requested_started, &p->max_threads) == 3 ||
+            sscanf(line, "  ready threads %d", &p->ready_threads) == 1 ||
+            sscanf(line, "  free async space %ld", &p->free_async_space) == 1 ||
+            sscanf(line, "  nodes: %d", &p->nodes) == 1 ||
+            sscanf(line, "  refs: %d", &p->refs) == 1 ||
+            sscanf(line, "  buffers: %d", &p->buffers) == 1 ||
+            sscanf(line, "  pages: %d", &p->pages_active) == 1 ||
+            sscanf(line, "  pending transactions: %d", &p->pending) == 1)
+            continue;
+
+        if (sscanf(line, "  %63[A-Z_]: %ld", name, &value) != 2)
+            continue;
+        if (!strcmp(name, "BC_TRANSACTION") || !strcmp(name, "BC_TRANSACTION_SG"))
+            p->bc_transaction += value;
+        else if (!strcmp(name, "BC_REPLY") || !strcmp(name, "BC_REPLY_SG"))
+            p->bc_reply += value;
+        else if (!strcmp(name, "BR_TRANSACTION") || !strcmp(name, "BR_TRANSACTION_SEC_CTX"))
+            p->br_transaction += value;
+        else if (!strcmp(name, "BR_FAILED_REPLY"))
+            p->br_failed_reply = value;
+        else if (!strcmp(name, "BR_DEAD_REPLY"))
+            p->br_dead_reply = value;
+        else if (!strcmp(name, "BR_FROZEN_REPLY"))
+            p->br_frozen_reply = value;
+        else if (!strcmp(name, "BR_ONEWAY_SPAM_SUSPECT"))
+            p->br_oneway_spam = value;
+    }
+}
+
+static void parse_state(struct snapshot *s, char *buf)
+{
+    char *line, *save;
+    int pid = 0;
+    char context[MAX_NAME] = "";
+    struct node_stat *n = NULL;
+    int id;
+
+    for_each_line(line, save, buf) {
+        if (sscanf(line, "proc %d", &pid) == 1) {
+            n = NULL;
+            continue;
+        }
+        if (!strcmp(line, "dead nodes:")) {
+            pid = 0;
+            continue;
+        }
+        if (sscanf(line, "context %63s", context) == 1)
+            continue;
+
+        if (sscanf(line, "  node %d:", &id) == 1) {
+            /*
+             * "node N: u... c... hs H hw H ls L lw L is S iw W tr T proc P1 P2 ...":
+             * iw counts the refs, one per process holding one, tr is the
+             * driver's temporary references to the node.
+             */
+            const char *iw = strstr(line, " iw ");
+            const char *tr = strstr(line, " tr ");
+
+            s->nodes = grow(s->nodes, s->nnodes, sizeof(*s->nodes));
+            n = &s->nodes[s->nnodes++];
+            memset(n, 0, sizeof(*n));
+            n->id = id;
+            n->owner = pid;
+            snprintf(n->context, MAX_NAME, "%s", context);
+            if (iw != NULL)
+                n->ref_procs = atoi(iw + 4);
+            if (tr != NULL)
+                n->tmp_refs = atoi(tr + 4);
+            continue;
+        }
+        if (n != NULL && !strncmp(line, "    pending async transaction", 29)) {
+            n->async_pending++;
+            continue;
+        }
+        if (line[0] == ' ' && line[1] == ' ' && line[2] != ' ')
+            n = NULL;
+    }
+}
+
+static void parse_transactions(struct snapshot *s, char *buf)
+{
+    char *line, *save;
+    int pid = -1;
+    struct proc_stat *p = NULL;
+    char context[MAX_NAME];
+    int from, from_tid, to, to_tid;
+    unsigned int flags;
+    const char *t;
+
+    for_each_line(line, save, buf) {
+        if (sscanf(line, "proc %d", &pid) == 1) {
+            p = NULL;
+            continue;
+        }
+        if (pid >= 0 && sscanf(line, "context %63s", context) == 1) {
+            p = find_proc(s, pid, context);
+            continue;
+        }
+        if (p == NULL)
+            continue;
+
+        t = strstr(line, " from ");
+        if (t == NULL || sscanf(t, " from %d:%d to %d:%d", &from, &from_tid, &to, &to_tid) != 4)
+            continue;
+
+        /* Every in-flight call shows up once as outgoing on the caller. */
+        if (strstr(line, "outgoing transaction")) {
+            p->outgoing++;
+            add_talker(s, from, to);
+        } else if (strstr(line, "incoming transaction")) {
+            p->incoming++;
+        } else if (strstr(line, "pending async transaction")) {
+            p->async_pending++;
+            add_talker(s, from, to);
+        } else if (strstr(line, "pending transaction")) {
+            /* A queued synchronous call is already outgoing on its caller. */
+            t = strstr(line, " flags ");
+            if (t != NULL && sscanf(t, " flags %x", &flags) == 1 && (flags & TF_ONE_WAY))
+                add_talker(s, from, to);
+        }
+    }
+}
+
+static void parse_failures(struct snapshot *s, char *buf)
+{
+    char *line, *save;
+    struct failure f;
+
+    for_each_line(line, save, buf) {
+        const char *ret;
+
+        memset(&f, 0, sizeof(f));
+        if (sscanf(line, "%d: %7s from %d:%*d to %d:%*d", &f.debug_id, f.type, &f.from,
+                   &f.to) != 4)
+            continue;
+        ret = strstr(line, " ret ");
+        if (ret != NULL)
+            sscanf(ret, " ret %d/%d l=%d", &f.ret, &f.param, &f.line);
+        s->failures = grow(s->failures, s->nfailures, sizeof(*s->failures));
+        s->failures[s->nfailures++] = f;
+    }
+}
+
+static int take_snapshot(const char *dir, struct snapshot *s)
+{
+    char *buf;
+
+    memset(s, 0, sizeof(*s));
+    if ((buf = read_file(dir, "stats")) == NULL)
+        return -1;
+    parse_stats(s, buf);
+    free(buf);
+
+    if ((buf = read_file(dir, "state")) != NULL) {
+        parse_state(s, buf);
+        free(buf);
+    }
+    if ((buf = read_file(dir, "transactions")) != NULL) {
+        parse_transactions(s, buf);
+        free(buf);
+    }
+    if ((buf = read_file(dir, "failed_transaction_log")) != NULL) {
+        parse_failures(s, buf);
+        free(buf);
+    }
+    return 0;
+}
+
+static void free_snapshot(struct snapshot *s)
+{
+    free(s->procs);
+    free(s->nodes);
+    free(s->talkers);
+    free(s->failures);
+    memset(s, 0, sizeof(*s));
+}
+
+static const struct proc_stat *find_prev(const struct snapshot *prev, const struct proc_stat *p)
+{
+    int i;
+
+    for (i = 0; prev != NULL && i < prev->nprocs; i++) {
+        if (prev->procs[i].pid == p->pid && !strcmp(prev->procs[i].context, p->context))
+            return &prev->procs[i];
+    }
+    return NULL;
+}
+
+/* Sort keys, set before qsort(). */
+static const struct snapshot *sort_prev;
+
+static long proc_activity(const struct proc_stat *p)
+{
+    const struct proc_stat *old = find_prev(sort_prev, p);
+    long calls = p->bc_transaction + p->br_transaction;
+
+    if (old != NULL)
+        calls -= old->bc_transaction + old->br_transaction;
+    return calls;
+}
+
+static int cmp_proc(const void *a, const void *b)
+{
+    const struct proc_stat *pa = a, *pb = b;
+    long ka = pa->outgoing + pa->incoming + pa->async_pending + pa->pending;
+    long kb = pb->outgoing + pb->incoming + pb->async_pending + pb->pending;
+
+    if (ka != kb)
+        return ka < kb ? 1 : -1;
+    ka = proc_activity(pa);
+    kb = proc_activity(pb);
+    if (ka != kb)
+        return ka < kb ? 1 : -1;
+    return pa->pid - pb->pid;
+}
+
+static int cmp_node(const void *a, const void *b)
+{
+    const struct node_stat *na = a, *nb = b;
+
+    if (na->async_pending != nb->async_pending)
+        return nb->async_pending - na->async_pending;
+    return nb->ref_procs - na->ref_procs;
+}
+
+static int cmp_talker(const void *a, const void *b)
+{
+    return ((const struct talker *)b)->count - ((const struct talker *)a)->count;
+}
+
+static void print_report(struct snapshot *s, const struct snapshot *prev, double interval,
+                         int only_pid, int top)
+{
+    int i, shown;
+    double scale = interval > 0 ? 1.0 / interval : 1.0;
+
+    sort_prev = prev;
+    qsort(s->procs, s->nprocs, sizeof(*s->procs), cmp_proc);
+    qsort(s->nodes, s->nnodes, sizeof(*s->nodes), cmp_node);
+    qsort(s->talkers, s->ntalkers, sizeof(*s->talkers), cmp_talker);
+
+    printf("%-7s %-10s %7s %5s %9s %10s %4s %5s %4s %4s %5s %5s %12s %12s %6s\n",
+           "PID", "CONTEXT", "THREADS", "READY", "REQ/MAX", "ASYNCFREE", "BUFS", "PAGES",
+           "OUT", "IN", "PEND", "ASYNC", prev ? "CALLS/s" : "CALLS", prev ? "REPLIES/s" : "REPLIES",
+           "FAILED");
+    for (i = 0, shown = 0; i < s->nprocs && (top <= 0 || shown < top); i++) {
+        const struct proc_stat *p = &s->procs[i];
+        const struct proc_stat *old = find_prev(prev, p);
+        char req[32];
+        long calls = p->bc_transaction, replies = p->bc_reply;
+        long failed = p->br_failed_reply + p->br_dead_reply + p->br_frozen_reply;
+
+        if (only_pid > 0 && p->pid != only_pid)
+            continue;
+        if (old != NULL) {
+            calls -= old->bc_transaction;
+            replies -= old->bc_reply;
+            failed -= old->br_failed_reply + old->br_dead_reply + old->br_frozen_reply;
+        }
+        snprintf(req, sizeof(req), "%d+%d/%d", p->requested, p->requested_started,
+                 p->max_threads);
+        printf("%-7d %-10s %7d %5d %9s %10ld %4d %5d %4d %4d %5d %5d %12.0f %12.0f %6ld%s\n",
+               p->pid, p->context, p->threads, p->ready_threads, req, p->free_async_space,
+               p->buffers, p->pages_active, p->outgoing, p->incoming, p->pending,
+               p->async_pending, prev ? calls * scale : calls, prev ? replies * scale : replies,
+               failed, p->br_oneway_spam > (old ? old->br_oneway_spam : 0) ? " SPAM" : "");
+        shown++;
+    }
+
+    printf("\n%-8s %-7s %-10s %8s %6s %6s\n", "NODE", "OWNER", "CONTEXT", "REFPROCS", "TMPREF",
+           "ASYNCQ");
+    for (i = 0, shown = 0; i < s->nnodes && (top <= 0 || shown < top); i++) {
+        const struct node_stat *n = &s->nodes[i];
+
+        if (only_pid > 0 && n->owner != only_pid)
+            continue;
+        printf("%-8d %-7d %-10s %8d %6d %6d\n", n->id, n->owner, n->context, n->ref_procs,
+               n->tmp_refs, n->async_pending);
+        shown++;
+    }
+
+    printf("\n%-7s %-7s %8s\n", "FROM", "TO", "INFLIGHT");
+    for (i = 0, shown = 0; i < s->ntalkers && (top <= 0 || shown < top); i++) {
+        const struct talker *t = &s->talkers[i];
+
+        if (only_pid > 0 && t->from != only_pid && t->to != only_pid)
+            continue;
+        printf("%-7d %-7d %8d\n", t->from, t->to, t->count);
+        shown++;
+    }
+
+    printf("\n%-8s %-5s %-7s %-7s %s\n", "FAILED", "TYPE", "FROM", "TO", "RET/PARAM LINE");
+    for (i = 0; i < s->nfailures; i++) {
+        const struct failure *f = &s->failures[i];
+        int j, seen = 0;
+
+        if (only_pid > 0 && f->from != only_pid && f->to != only_pid)
+            continue;
+        /* In watch mode only report failures that are new since last time. */
+        for (j = 0; prev != NULL && j < prev->nfailures && !seen; j++)
+            seen = prev->failures[j].debug_id == f->debug_id;
+        if (seen)
+            continue;
+        printf("%-8d %-5s %-7d %-7d %d/%d l=%d\n", f->debug_id, f->type, f->from, f->to,
+               f->ret, f->param, f->line);
+    }
+}
+
+static void usage(const char *prog)
+{
+    printf("Usage: %s [-d binder_logs dir] [-p pid] [-n top] [-w seconds [-c count]]\n"
+           "\n"
+           "  -d DIR   binderfs log directory (default: " DEFAULT_LOG_DIR ")\n"
+           "  -p PID   only report on PID\n"
+           "  -n N     show the top N rows per table (default: 20, 0 for all)\n"
+           "  -w SEC   watch mode, print deltas every SEC seconds\n"
+           "  -c N     stop after N reports in watch mode\n"
+           "\nExample)\n$ %s -w 1 -n 10\n",
+           prog, prog);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *dir = DEFAULT_LOG_DIR;
+    int only_pid = 0, top = 20, count = 0, c, i;
+    double interval = 0;
+    struct snapshot prev, cur;
+
+    while ((c = getopt(argc, argv, "d:p:n:w:c:h")) != -1) {
+        switch (c) {
+        case 'd': dir = optarg; break;
+        case 'p': only_pid = atoi(optarg); break;
+        case 'n': top = atoi(optarg); break;
+        case 'w': interval = atof(optarg); break;
+        case 'c': count = atoi(optarg); break;
+        default:
+            usage(argv[0]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (take_snapshot(dir, &prev) < 0)
+        exit(EXIT_FAILURE);
+
+    if (interval <= 0) {
+        print_report(&prev, NULL, 0, only_pid, top);
+        free_snapshot(&prev);
+        exit(EXIT_SUCCESS);
+    }
+
+    for (i = 0; count <= 0 || i < count; i++) {
+        struct timespec ts = { (time_t)interval, (long)((interval - (time_t)interval) * 1e9) };
+        time_t now;
+        char stamp[64];
+
+        nanosleep(&ts, NULL);
+        if (take_snapshot(dir, &cur) < 0)
+            exit(EXIT_FAILURE);
+
+        now = time(NULL);
+        strftime(stamp, sizeof(stamp), "%F %T", localtime(&now));
+        printf("==== %s (%.1fs) ====\n", stamp, interval);
+        print_report(&cur, &prev, interval, only_pid, top);
+        printf("\n");
+        fflush(stdout);
+
+        free_snapshot(&prev);
+        prev = cur;
+    }
+
+    free_snapshot(&prev);
+    exit(EXIT_SUCCESS);
+}